@@ -0,0 +1,86 @@
+/*ds1307 async deadline test - Reza Ebrahimi v1.0*/
+/*host program for the DS1307_I2C_TIMEOUT_US deadline of the async calls, on the simulator:
+    cc -O2 -DDS1307_ASYNC=1 -I. -IExample -o async_test Example/rtc_ds1307_async_test.c rtc_ds1307.c Example/rtc_ds1307_low_level_sim.c && ./async_test
+  a submitted transaction whose completion is lost (DS1307_sim_lose) keeps the call busy until the
+  deadline, then DS1307_async_poll frees the bus, the callback runs once with OPERATION_FAILED and the
+  handle takes the next async call. a NACKed transaction still fails at once, without the deadline*/
+#include <stdio.h>
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_sim.h"
+
+#define TEST_POLL_US            100        /*simulated time between two polls*/
+
+static ds1307_t test_rtc;
+static uint8_t test_start_time[7] = {0, 0, 12, 2, 1, 1, 24};        /*12:00:00 monday 2024-01-01*/
+
+struct test_callback_record {
+  uint32_t calls;
+  uint8_t status;
+};
+
+static void test_callback(ds1307_t *rtc, uint8_t status, void *callback_context)
+{
+  struct test_callback_record *record = callback_context;
+  (void)rtc;
+  record->calls++;
+  record->status = status;
+}
+
+/*polls an async read of TIME until it is over, returns its status and its simulated time in *elapsed_us*/
+static uint8_t test_read(uint8_t *data_array, struct test_callback_record *record, uint32_t *elapsed_us)
+{
+  uint8_t status;
+  *elapsed_us = 0;
+  record->calls = 0;
+  if (DS1307_read_async(&test_rtc, TIME, data_array, test_callback, record) != OPERATION_DONE)
+    return OPERATION_FAILED;
+  while ((status = DS1307_async_poll(&test_rtc)) == DS1307_ASYNC_BUSY)
+  {
+    DS1307_sim_advance_us(TEST_POLL_US);
+    *elapsed_us += TEST_POLL_US;
+  }
+  return status;
+}
+
+/*returns 1 if the result is not what the case expects*/
+static uint32_t test_check(const char *name, uint8_t status, uint8_t expected_status, const struct test_callback_record *record, uint32_t elapsed_us, uint32_t recoveries)
+{
+  struct ds1307_sim_stats stats;
+  uint8_t match;
+  DS1307_sim_stats(0, &stats);
+  match = (status == expected_status) && (record->calls == 1) && (record->status == expected_status) && (stats.recoveries == recoveries);
+  printf("  %-34s %-6s after %5u us, %u callbacks, %u recoveries %s\n", name, (status == OPERATION_DONE) ? "done" : "failed", elapsed_us, record->calls, stats.recoveries, match ? "ok" : "FAILED");
+  return match ? 0 : 1;
+}
+
+int main(void)
+{
+  struct test_callback_record record;
+  uint8_t async_array[7], blocking_array[7];
+  uint8_t status;
+  uint32_t elapsed_us, errors = 0;
+  DS1307_handle_init(&test_rtc, 0, DS1307_I2C_ADDRESS);
+  DS1307_init(&test_rtc, test_start_time, CLOCK_HALT, FORCE_RESET);
+  DS1307_sim_stats_reset(0);
+  /*a completion that comes: done well before the deadline*/
+  status = test_read(async_array, &record, &elapsed_us);
+  errors += test_check("completed read", status, OPERATION_DONE, &record, elapsed_us, 0);
+  errors += (elapsed_us >= DS1307_I2C_TIMEOUT_US);
+  /*a completion that is lost: failed once the deadline has passed, with the bus freed*/
+  DS1307_sim_lose(0, 1);
+  status = test_read(async_array, &record, &elapsed_us);
+  errors += test_check("lost completion", status, OPERATION_FAILED, &record, elapsed_us, 1);
+  errors += ((elapsed_us < DS1307_I2C_TIMEOUT_US) || (elapsed_us > (DS1307_I2C_TIMEOUT_US + (2 * TEST_POLL_US))));
+  /*a NACK is reported by its completion, no deadline and no recovery from the poll*/
+  DS1307_sim_fail(0, 1);
+  status = test_read(async_array, &record, &elapsed_us);
+  errors += test_check("nacked read", status, OPERATION_FAILED, &record, elapsed_us, 1);
+  /*the handle takes the next call and reads the same time as a blocking read*/
+  status = test_read(async_array, &record, &elapsed_us);
+  errors += test_check("read after the deadline", status, OPERATION_DONE, &record, elapsed_us, 1);
+  DS1307_read(&test_rtc, TIME, blocking_array);
+  for (uint8_t index = 0; index < 7; index++)
+    errors += (async_array[index] != blocking_array[index]);
+  printf("async deadline: %s (%u mismatches)\n", errors ? "FAILED" : "ok", errors);
+  return errors ? 1 : 0;
+}
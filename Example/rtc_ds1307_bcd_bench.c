@@ -0,0 +1,104 @@
+/*ds1307 bcd conversion check and benchmark - Reza Ebrahimi v1.0*/
+/*host program for the three DS1307_BCD_CONVERSION methods. the driver is included as source so the
+  internal BCD_to_HEX and HEX_to_BCD are reached as they are built, one method per build:
+    for method in LOOP TABLE SWAR; do
+      cc -O2 -I. -IExample -DDS1307_BCD_CONVERSION=DS1307_BCD_$method -o bcd_bench Example/rtc_ds1307_bcd_bench.c Example/rtc_ds1307_low_level_sim.c && ./bcd_bench
+    done
+  every value 0 to 99 is checked at every position of arrays of 1 to 8 bytes, both ways, against a
+  plain division, then 7 byte conversions (what a TIME read or set costs) are timed*/
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <time.h>
+#include "../rtc_ds1307.c"
+
+#define BENCH_ROUNDS            10000000UL
+#define BENCH_LENGTH_MAX        8
+#define BENCH_TABLE_SIZE        256        /*input arrays, a power of 2*/
+
+static const char *bench_method_name(void)
+{
+#if DS1307_BCD_CONVERSION == DS1307_BCD_SWAR
+  return "SWAR";
+#elif DS1307_BCD_CONVERSION == DS1307_BCD_TABLE
+  return "TABLE";
+#else
+  return "LOOP";
+#endif
+}
+
+static double bench_now_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((double)now.tv_sec * 1e9) + now.tv_nsec;
+}
+
+/*filler of the other bytes, so a method that mixes up lanes shows up*/
+static uint8_t bench_filler(uint8_t value, uint8_t index)
+{
+  return (uint8_t)(((value * 7) + (index * 13) + 1) % 100);
+}
+
+/*returns the number of mismatches, each one is printed*/
+static uint32_t bench_check(void)
+{
+  uint8_t hex_array[BENCH_LENGTH_MAX], bcd_array[BENCH_LENGTH_MAX], expected;
+  uint32_t errors = 0;
+  for (uint8_t length = 1; length <= BENCH_LENGTH_MAX; length++)
+    for (uint8_t position = 0; position < length; position++)
+      for (uint8_t value = 0; value < 100; value++)
+      {
+        for (uint8_t index = 0; index < length; index++)
+        {
+          hex_array[index] = (index == position) ? value : bench_filler(value, index);
+          bcd_array[index] = (uint8_t)(((hex_array[index] / 10) << 4) | (hex_array[index] % 10));
+        }
+        HEX_to_BCD(hex_array, length);
+        BCD_to_HEX(bcd_array, length);
+        for (uint8_t index = 0; index < length; index++)
+        {
+          expected = (index == position) ? value : bench_filler(value, index);
+          if ((hex_array[index] != (((expected / 10) << 4) | (expected % 10))) || (bcd_array[index] != expected))
+          {
+            if (errors++ < 10)
+              printf("  mismatch: length %u position %u value %u byte %u: bcd 0X%02X hex %u\n", length, position, value, index, hex_array[index], bcd_array[index]);
+          }
+        }
+      }
+  return errors;
+}
+
+/*average ns of one 7 byte conversion over BENCH_ROUNDS arrays from input_table, or of the copy alone*/
+static double bench_time(void (*convert)(uint8_t *, uint8_t), uint8_t input_table[][7])
+{
+  static uint8_t time_array[7];
+  volatile uint8_t sink = 0;
+  double start_ns = bench_now_ns();
+  for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (uint8_t index = 0; index < 7; index++)
+      time_array[index] = input_table[round & (BENCH_TABLE_SIZE - 1)][index];
+    if (convert)
+      convert(time_array, 7);
+    sink ^= time_array[round % 7];
+  }
+  (void)sink;
+  return (bench_now_ns() - start_ns) / BENCH_ROUNDS;
+}
+
+int main(void)
+{
+  static uint8_t hex_table[BENCH_TABLE_SIZE][7], bcd_table[BENCH_TABLE_SIZE][7];
+  double copy_ns;
+  uint32_t errors = bench_check();
+  printf("DS1307_BCD_%s: %s (%u mismatches over 0 to 99, lengths 1 to %u)\n", bench_method_name(), errors ? "FAILED" : "ok", errors, BENCH_LENGTH_MAX);
+  for (uint32_t row = 0; row < BENCH_TABLE_SIZE; row++)
+    for (uint8_t index = 0; index < 7; index++)
+    {
+      hex_table[row][index] = (uint8_t)(((row * 37) + (index * 11)) % 60);
+      bcd_table[row][index] = (uint8_t)(((hex_table[row][index] / 10) << 4) | (hex_table[row][index] % 10));
+    }
+  copy_ns = bench_time(0, hex_table);
+  printf("  7 bytes: HEX_to_BCD %.2f ns, BCD_to_HEX %.2f ns (copy of the input taken off)\n", bench_time(HEX_to_BCD, hex_table) - copy_ns, bench_time(BCD_to_HEX, bcd_table) - copy_ns);
+  return errors ? 1 : 0;
+}
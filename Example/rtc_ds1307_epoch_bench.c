@@ -0,0 +1,163 @@
+/*ds1307 epoch conversion check and benchmark - Reza Ebrahimi v1.0*/
+/*host program for the closed form time_to_seconds, seconds_to_time and days_from_civil behind
+  DS1307_read_epoch and DS1307_set_epoch. the driver is included as source so the internal functions
+  are reached as they are built:
+    cc -O2 -I. -IExample -o epoch_bench Example/rtc_ds1307_epoch_bench.c Example/rtc_ds1307_low_level_sim.c && ./epoch_bench
+  every day of 2000 to 2099 is checked at a few times of day against gmtime and timegm of the host,
+  both ways and with the day of week, then once more through DS1307_set_epoch and DS1307_read_epoch
+  on the simulator (halted, so the registers hold what was written). then the closed forms are timed
+  against a naive version that walks the years and months one by one*/
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <time.h>
+#include "rtc_ds1307_sim.h"
+#include "../rtc_ds1307.c"
+
+#define BENCH_ROUNDS            10000000UL
+#define BENCH_TABLE_SIZE        4096        /*inputs, a power of 2*/
+#define BENCH_DAYS              36525        /*2000-01-01 to 2099-12-31*/
+
+static const uint32_t bench_time_of_day[] = {0, 1, 43199, 43200, 86399};        /*midnight, noon and the last second of a day*/
+
+static double bench_now_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((double)now.tv_sec * 1e9) + now.tv_nsec;
+}
+
+/*naive seconds_to_time: whole years, then whole months are taken off the days one at a time*/
+static void naive_seconds_to_time(uint32_t seconds, uint8_t *data_array)
+{
+  uint32_t days = seconds / 86400UL;
+  uint8_t year = 0, month = 0, month_length;
+  seconds %= 86400UL;
+  data_array[0] = seconds % 60;
+  data_array[1] = (seconds / 60) % 60;
+  data_array[2] = seconds / 3600;
+  data_array[3] = ((days + 6) % 7) + 1;
+  while (days >= (uint32_t)((year & 0X03) ? 365 : 366))
+    days -= (year++ & 0X03) ? 365 : 366;
+  for (;;)
+  {
+    month_length = days_in_month[month] + ((month == 1) && !(year & 0X03));
+    if (days < month_length)
+      break;
+    days -= month_length;
+    month++;
+  }
+  data_array[4] = days + 1;
+  data_array[5] = month + 1;
+  data_array[6] = year;
+}
+
+/*naive time_to_seconds: the lengths of the years and months before the date are added up*/
+static uint32_t naive_time_to_seconds(const uint8_t *data_array)
+{
+  uint32_t days = data_array[4] - 1;
+  for (uint8_t year = 0; year < data_array[6]; year++)
+    days += (year & 0X03) ? 365 : 366;
+  for (uint8_t month = 0; month < (data_array[5] - 1); month++)
+    days += days_in_month[month] + ((month == 1) && !(data_array[6] & 0X03));
+  return (days * 86400UL) + (data_array[2] * 3600UL) + (data_array[1] * 60) + data_array[0];
+}
+
+/*1 if a decoded time array and a struct tm of the host are the same time*/
+static uint8_t bench_match(const uint8_t *data_array, const struct tm *host_time)
+{
+  return (data_array[0] == host_time->tm_sec) && (data_array[1] == host_time->tm_min) && (data_array[2] == host_time->tm_hour) &&
+         (data_array[3] == (host_time->tm_wday + 1)) && (data_array[4] == host_time->tm_mday) &&
+         (data_array[5] == (host_time->tm_mon + 1)) && (data_array[6] == (host_time->tm_year - 100));
+}
+
+/*returns the number of mismatches, the first ones are printed*/
+static uint32_t bench_check(void)
+{
+  uint8_t data_array[7], naive_array[7];
+  struct tm host_time;
+  time_t host_seconds;
+  uint32_t seconds, errors = 0;
+  for (uint32_t day = 0; day < BENCH_DAYS; day++)
+    for (uint8_t index = 0; index < (sizeof(bench_time_of_day) / sizeof(bench_time_of_day[0])); index++)
+    {
+      seconds = (day * 86400UL) + bench_time_of_day[index];
+      host_seconds = (time_t)(DS1307_EPOCH_2000 + seconds);
+      gmtime_r(&host_seconds, &host_time);
+      seconds_to_time(seconds, data_array);
+      naive_seconds_to_time(seconds, naive_array);
+      if (!bench_match(data_array, &host_time) || !bench_match(naive_array, &host_time) ||
+          (time_to_seconds(data_array) != seconds) || (naive_time_to_seconds(data_array) != seconds) ||
+          ((uint32_t)(timegm(&host_time) - DS1307_EPOCH_2000) != seconds) ||
+          (days_from_civil(data_array[6], data_array[5], data_array[4]) != day))
+      {
+        if (errors++ < 10)
+          printf("  mismatch: %u: %02u-%02u-%02u %02u:%02u:%02u day %u\n", (unsigned)(DS1307_EPOCH_2000 + seconds), data_array[6], data_array[5], data_array[4], data_array[2], data_array[1], data_array[0], data_array[3]);
+      }
+    }
+  return errors;
+}
+
+/*the same days through the public calls and the simulated registers. returns the number of mismatches*/
+static uint32_t bench_check_driver(void)
+{
+  static struct ds1307_sim sim;
+  ds1307_t rtc;
+  uint32_t epoch, read_back, errors = 0;
+  DS1307_handle_init(&rtc, &sim, DS1307_I2C_ADDRESS);
+  DS1307_sim_power_on(&sim);
+  for (uint32_t day = 0; day < BENCH_DAYS; day++)
+    for (uint8_t index = 0; index < (sizeof(bench_time_of_day) / sizeof(bench_time_of_day[0])); index++)
+    {
+      epoch = DS1307_EPOCH_2000 + (day * 86400UL) + bench_time_of_day[index];
+      read_back = 0;
+      if ((DS1307_set_epoch(&rtc, epoch) != OPERATION_DONE) || (DS1307_read_epoch(&rtc, &read_back) != OPERATION_DONE) || (read_back != epoch))
+      {
+        if (errors++ < 10)
+          printf("  mismatch: set %u read %u\n", (unsigned)epoch, (unsigned)read_back);
+      }
+    }
+  if ((DS1307_set_epoch(&rtc, DS1307_EPOCH_2000 - 1) != OPERATION_FAILED) || (DS1307_set_epoch(&rtc, DS1307_EPOCH_2100) != OPERATION_FAILED))
+  {
+    printf("  times outside 2000 to 2099 are not refused\n");
+    errors++;
+  }
+  return errors;
+}
+
+/*average ns of one conversion of each way over BENCH_ROUNDS inputs from seconds_table*/
+static void bench_time(void (*to_time)(uint32_t, uint8_t *), uint32_t (*to_seconds)(const uint8_t *), const uint32_t *seconds_table, double *to_time_ns, double *to_seconds_ns)
+{
+  static uint8_t time_table[BENCH_TABLE_SIZE][7];
+  volatile uint32_t sink = 0;
+  double start_ns = bench_now_ns();
+  for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+  {
+    to_time(seconds_table[round & (BENCH_TABLE_SIZE - 1)], time_table[round & (BENCH_TABLE_SIZE - 1)]);
+    sink ^= time_table[round & (BENCH_TABLE_SIZE - 1)][4];
+  }
+  *to_time_ns = (bench_now_ns() - start_ns) / BENCH_ROUNDS;
+  start_ns = bench_now_ns();
+  for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    sink ^= to_seconds(time_table[round & (BENCH_TABLE_SIZE - 1)]);
+  *to_seconds_ns = (bench_now_ns() - start_ns) / BENCH_ROUNDS;
+  (void)sink;
+}
+
+int main(void)
+{
+  static uint32_t seconds_table[BENCH_TABLE_SIZE];
+  double closed_to_time_ns, closed_to_seconds_ns, naive_to_time_ns, naive_to_seconds_ns;
+  uint32_t errors = bench_check();
+  uint32_t driver_errors = bench_check_driver();
+  printf("conversions: %s (%u mismatches against gmtime and timegm over %u days)\n", errors ? "FAILED" : "ok", errors, BENCH_DAYS);
+  printf("DS1307_set_epoch and DS1307_read_epoch: %s (%u mismatches)\n", driver_errors ? "FAILED" : "ok", driver_errors);
+  /*spread over the whole range, so the naive loops run for 50 years on average*/
+  for (uint32_t index = 0; index < BENCH_TABLE_SIZE; index++)
+    seconds_table[index] = (uint32_t)(((uint64_t)index * 2654435761UL) % (BENCH_DAYS * 86400ULL));
+  bench_time(seconds_to_time, time_to_seconds, seconds_table, &closed_to_time_ns, &closed_to_seconds_ns);
+  bench_time(naive_seconds_to_time, naive_time_to_seconds, seconds_table, &naive_to_time_ns, &naive_to_seconds_ns);
+  printf("  closed form: seconds_to_time %.2f ns, time_to_seconds %.2f ns\n", closed_to_time_ns, closed_to_seconds_ns);
+  printf("  naive loops: seconds_to_time %.2f ns, time_to_seconds %.2f ns\n", naive_to_time_ns, naive_to_seconds_ns);
+  return (errors || driver_errors) ? 1 : 0;
+}
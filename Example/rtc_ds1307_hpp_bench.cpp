@@ -0,0 +1,129 @@
+/*ds1307 c++ template against c api comparison - Reza Ebrahimi v1.0*/
+/*host program for rtc_ds1307.hpp. both drivers run on the default simulated chip: every field the
+  template reads is checked against DS1307_read, then the same calls of both are timed. the simulator
+  only counts the bus time, so the host time of a call is the driver overhead plus the simulator:
+    cc -O2 -c -I. -IExample rtc_ds1307.c Example/rtc_ds1307_low_level_sim.c
+    c++ -std=c++11 -O2 -I. -IExample -o hpp_bench Example/rtc_ds1307_hpp_bench.cpp rtc_ds1307.o rtc_ds1307_low_level_sim.o && ./hpp_bench
+  the code size of the same three calls (a field read, a time read and a field write) is compared by
+  building the program with HPP_BENCH_SIZE as 1 (c api), 2 (template) or 0 (neither, the baseline),
+  with unused functions dropped at link time:
+    cc -Os -ffunction-sections -fdata-sections -c -I. -IExample rtc_ds1307.c Example/rtc_ds1307_low_level_sim.c
+    for api in 0 1 2; do
+      c++ -std=c++11 -Os -ffunction-sections -fdata-sections -Wl,--gc-sections -DHPP_BENCH_SIZE=$api -I. -IExample -o hpp_size Example/rtc_ds1307_hpp_bench.cpp rtc_ds1307.o rtc_ds1307_low_level_sim.o && size hpp_size
+    done*/
+#include <stdio.h>
+#include <time.h>
+#include "rtc_ds1307.hpp"
+#include "rtc_ds1307_sim.h"
+
+#define BENCH_ROUNDS            1000000UL
+
+#ifdef HPP_BENCH_SIZE
+volatile uint8_t bench_sink;
+
+int main()
+{
+#if HPP_BENCH_SIZE == 1
+  static ds1307_t rtc;
+  uint8_t value = 30, time_array[7];
+  DS1307_handle_init(&rtc, 0, DS1307_I2C_ADDRESS);
+  DS1307_read(&rtc, MINUTE, time_array);
+  DS1307_read(&rtc, TIME, time_array);
+  DS1307_set(&rtc, MINUTE, &value);
+  bench_sink = time_array[3];
+#elif HPP_BENCH_SIZE == 2
+  rtc_ds1307::Ds1307<> chip;
+  uint8_t time_array[7];
+  chip.read<rtc_ds1307::Field::Minute>(time_array[0]);
+  chip.read_time(time_array);
+  chip.write<rtc_ds1307::Field::Minute>(30);
+  bench_sink = time_array[3];
+#endif
+  return 0;
+}
+#else
+static ds1307_t bench_rtc;
+static rtc_ds1307::Ds1307<> bench_chip;
+static volatile uint8_t bench_sink;
+
+static double bench_now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((double)now.tv_sec * 1e9) + now.tv_nsec;
+}
+
+/*average host ns and simulated bus us of one call of body*/
+template <class Body>
+static void bench_time(const char *name, Body body)
+{
+  struct ds1307_sim_stats stats;
+  double start_ns;
+  DS1307_sim_stats_reset(0);
+  start_ns = bench_now_ns();
+  for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    body(round);
+  start_ns = (bench_now_ns() - start_ns) / BENCH_ROUNDS;
+  DS1307_sim_stats(0, &stats);
+  printf("  %-34s %7.1f ns host, %6.1f us bus, %.1f transactions\n", name, start_ns, (double)stats.bus_time_ns / 1000 / BENCH_ROUNDS, (double)stats.transactions / BENCH_ROUNDS);
+}
+
+/*returns the number of fields where the template and DS1307_read differ*/
+template <rtc_ds1307::Field F>
+static uint32_t bench_check_field(const char *name, uint8_t option)
+{
+  uint8_t template_value = 0XFF, c_value = 0XFE;
+  if ((bench_chip.read<F>(template_value) != OPERATION_DONE) || (DS1307_read(&bench_rtc, option, &c_value) != OPERATION_DONE) || (template_value != c_value))
+  {
+    printf("  mismatch: %s template %u c %u\n", name, template_value, c_value);
+    return 1;
+  }
+  return 0;
+}
+
+static uint32_t bench_check()
+{
+  uint8_t time_array[7] = {55, 59, 23, 5, 28, 2, 24};
+  uint8_t template_array[7], c_array[7];
+  uint32_t errors = 0;
+  DS1307_init(&bench_rtc, time_array, CLOCK_HALT, FORCE_RESET);
+  errors += bench_check_field<rtc_ds1307::Field::Second>("second", SECOND);
+  errors += bench_check_field<rtc_ds1307::Field::Minute>("minute", MINUTE);
+  errors += bench_check_field<rtc_ds1307::Field::Hour>("hour", HOUR);
+  errors += bench_check_field<rtc_ds1307::Field::DayOfWeek>("day of week", DAY_OF_WEEK);
+  errors += bench_check_field<rtc_ds1307::Field::Date>("date", DATE);
+  errors += bench_check_field<rtc_ds1307::Field::Month>("month", MONTH);
+  errors += bench_check_field<rtc_ds1307::Field::Year>("year", YEAR);
+  errors += bench_check_field<rtc_ds1307::Field::Control>("control", CONTROL);
+  if ((bench_chip.read_time(template_array) != DS1307_run_state(&bench_rtc)) || (DS1307_read(&bench_rtc, TIME, c_array) != OPERATION_DONE))
+    errors++;
+  for (uint8_t index = 0; index < 7; index++)
+    if (template_array[index] != c_array[index])
+    {
+      printf("  mismatch: time byte %u template %u c %u\n", index, template_array[index], c_array[index]);
+      errors++;
+    }
+  /*a write through the template keeps CH, so the c api still sees a halted clock*/
+  if ((bench_chip.write<rtc_ds1307::Field::Second>(12) != OPERATION_DONE) || (DS1307_run_state(&bench_rtc) != DS1307_IS_STOPPED))
+    errors++;
+  errors += bench_check_field<rtc_ds1307::Field::Second>("second after write", SECOND);
+  return errors;
+}
+
+int main()
+{
+  uint32_t errors;
+  DS1307_handle_init(&bench_rtc, 0, DS1307_I2C_ADDRESS);
+  DS1307_sim_power_on(0);
+  errors = bench_check();
+  printf("template against c api: %s (%u mismatches)\n", errors ? "FAILED" : "ok", errors);
+  DS1307_run(&bench_rtc, CLOCK_RUN);
+  bench_time("DS1307_read(&rtc, MINUTE, &value)", [](uint32_t) { uint8_t value; DS1307_read(&bench_rtc, MINUTE, &value); bench_sink = value; });
+  bench_time("chip.read<Field::Minute>(value)", [](uint32_t) { uint8_t value = 0; bench_chip.read<rtc_ds1307::Field::Minute>(value); bench_sink = value; });
+  bench_time("DS1307_read(&rtc, TIME, time_array)", [](uint32_t) { uint8_t time_array[7]; DS1307_read(&bench_rtc, TIME, time_array); bench_sink = time_array[3]; });
+  bench_time("chip.read_time(time_array)", [](uint32_t) { uint8_t time_array[7]; bench_chip.read_time(time_array); bench_sink = time_array[3]; });
+  bench_time("DS1307_set(&rtc, MINUTE, &value)", [](uint32_t round) { uint8_t value = round % 60; DS1307_set(&bench_rtc, MINUTE, &value); });
+  bench_time("chip.write<Field::Minute>(value)", [](uint32_t round) { bench_chip.write<rtc_ds1307::Field::Minute>(round % 60); });
+  return errors ? 1 : 0;
+}
+#endif
@@ -4,65 +4,160 @@
 #include <Wire.h>       /*added for arduino*/
 
 #define I2C_SPEED       100000        /*according to datasheet, ds1307 supports 100khz i2c speed*/
+#define I2C_BUFFER_LENGTH       32        /*arduino Wire buffer size, longer bursts are split into chunks*/
+#define I2C_WIRE(bus)           ((bus) ? (TwoWire *)(bus) : &Wire)        /*bus is a TwoWire (&Wire, &Wire1...), NULL for Wire*/
+#define I2C_RECOVER_CLOCKS      9        /*SCL pulses that free a slave stuck in the middle of a byte*/
 
 /*function to transmit one byte of data to register_address on ds1307 (device_address: 0X68)*/
-void time_i2c_write_single(uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+uint8_t time_i2c_write_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
 {
-  Wire.beginTransmission(device_address);
-  Wire.write(register_address);
-  Wire.write(*data_byte);
-  Wire.endTransmission(device_address);
+  TwoWire *wire = I2C_WIRE(bus);
+  wire->beginTransmission(device_address);
+  wire->write(register_address);
+  wire->write(*data_byte);
+  /*0 is success, anything else is a NACK, a bus error or a timeout*/
+  if (wire->endTransmission(device_address))
+    return OPERATION_FAILED;
+  return OPERATION_DONE;
 }
 
 /*function to transmit an array of data to device_address, starting from start_register_address*/
-void time_i2c_write_multi(uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+uint8_t time_i2c_write_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
 {
-  /*choose i2c device_address*/
-  Wire.beginTransmission(device_address);
-  /*choose the starting register on device*/
-  Wire.write(start_register_address);
-  /*transmit an array of data to the device*/
-  for (; data_length; data_length--)
+  TwoWire *wire = I2C_WIRE(bus);
+  uint8_t chunk_length;
+  while (data_length)
   {
-    Wire.write(*data_array);
-    data_array++;
+    /*one byte of the Wire buffer is taken by the register address*/
+    chunk_length = (data_length > (I2C_BUFFER_LENGTH - 1)) ? (I2C_BUFFER_LENGTH - 1) : data_length;
+    /*choose i2c device_address*/
+    wire->beginTransmission(device_address);
+    /*choose the starting register on device*/
+    wire->write(start_register_address);
+    /*transmit an array of data to the device*/
+    for (uint8_t index = chunk_length; index; index--)
+    {
+      wire->write(*data_array);
+      data_array++;
+    }
+    if (wire->endTransmission(device_address))
+      return OPERATION_FAILED;
+    start_register_address += chunk_length;
+    data_length -= chunk_length;
   }
-  Wire.endTransmission(device_address);
+  return OPERATION_DONE;
 }
 
 /*function to read one byte of data from register_address on ds1307*/
-void time_i2c_read_single(uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+uint8_t time_i2c_read_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
 {
-  Wire.beginTransmission(device_address);
-  Wire.write(register_address);
-  Wire.endTransmission(device_address);
-  Wire.requestFrom(uint16_t(device_address), 1, 0);
-  while (Wire.available())
+  TwoWire *wire = I2C_WIRE(bus);
+  wire->beginTransmission(device_address);
+  wire->write(register_address);
+  if (wire->endTransmission(device_address))
+    return OPERATION_FAILED;
+  /*requestFrom returns the bytes received, fewer than asked for is a NACK or a timeout*/
+  if (wire->requestFrom(uint16_t(device_address), 1, 0) != 1)
+    return OPERATION_FAILED;
+  *data_byte = wire->read();
+  return OPERATION_DONE;
+}
+
+/*function to read an array of data from device_address*/
+uint8_t time_i2c_read_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  TwoWire *wire = I2C_WIRE(bus);
+  uint8_t chunk_length;
+  while (data_length)
   {
-    *data_byte = Wire.read();
+    chunk_length = (data_length > I2C_BUFFER_LENGTH) ? I2C_BUFFER_LENGTH : data_length;
+    /*setting the i2c device_address to read data*/
+    wire->beginTransmission(device_address);
+    wire->write(start_register_address);
+    if (wire->endTransmission(device_address))
+      return OPERATION_FAILED;
+    /*requesting chunk_length bytes of data from device_address*/
+    if (wire->requestFrom(uint16_t(device_address), uint16_t(chunk_length), 0) != chunk_length)
+      return OPERATION_FAILED;
+    /*reading the requested data, all of it is in the Wire buffer already*/
+    for (uint8_t index = chunk_length; index; index--)
+    {
+      *data_array = wire->read();
+      data_array++;
+    }
+    start_register_address += chunk_length;
+    data_length -= chunk_length;
   }
+  return OPERATION_DONE;
 }
 
-/*function to read an array of data from device_address*/
-void time_i2c_read_multi(uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+/*function to free the bus after a failed transfer. a ds1307 reset in the middle of a read can hold
+  SDA low until it has clocked out its byte: SCL is pulsed by hand until SDA is high, a STOP is made
+  and Wire is started again. only done for Wire, whose pins are SDA and SCL*/
+void time_i2c_recover(void *bus)
 {
-  /*setting the i2c device_address to read data*/
-  Wire.beginTransmission(device_address);
-  Wire.write(start_register_address);
-  Wire.endTransmission(device_address);
-  /*requesting data_length bytes of data from device_address*/
-  Wire.requestFrom(uint16_t(device_address), uint16_t(data_length), 0);
-  /*polling and reading the requested data*/
-  while (Wire.available())
+  TwoWire *wire = I2C_WIRE(bus);
+#if defined(SDA) && defined(SCL)
+  if (wire == &Wire)
   {
-    *data_array = Wire.read();
-    data_array++;
+    wire->end();
+    pinMode(SDA, INPUT_PULLUP);
+    pinMode(SCL, INPUT_PULLUP);
+    for (uint8_t index = 0; (index < I2C_RECOVER_CLOCKS) && (digitalRead(SDA) == LOW); index++)
+    {
+      pinMode(SCL, OUTPUT);
+      digitalWrite(SCL, LOW);
+      delayMicroseconds(5);
+      pinMode(SCL, INPUT_PULLUP);
+      delayMicroseconds(5);
+    }
+    /*STOP: SDA rises while SCL is high*/
+    pinMode(SDA, OUTPUT);
+    digitalWrite(SDA, LOW);
+    delayMicroseconds(5);
+    pinMode(SDA, INPUT_PULLUP);
+    delayMicroseconds(5);
   }
+#endif
+  DS1307_I2C_init(bus);
+}
+
+#if DS1307_ASYNC
+/*function to start a transaction on the bus and return, DS1307_async_complete(transaction->rtc, status)
+  is called once it is over. Wire blocks, so the transfer is made here and completed at once.
+  replace it with an interrupt driven twi driver to free the cpu during the transfer*/
+void time_i2c_submit(void *bus, struct ds1307_transaction *transaction)
+{
+  uint8_t status;
+  if (transaction->direction == DS1307_TRANSACTION_WRITE)
+    status = time_i2c_write_multi(bus, transaction->device_address, transaction->register_address, transaction->data_array, transaction->data_length);
+  else
+    status = time_i2c_read_multi(bus, transaction->device_address, transaction->register_address, transaction->data_array, transaction->data_length);
+  DS1307_async_complete(transaction->rtc, status);
 }
+#endif
 
 /*function to initialize I2C peripheral in 100khz*/
-void DS1307_I2C_init()
+void DS1307_I2C_init(void *bus)
+{
+  TwoWire *wire = I2C_WIRE(bus);
+  wire->begin();
+  wire->setClock(I2C_SPEED);
+#if defined(WIRE_HAS_TIMEOUT)
+  /*avr Wire waits forever on a bus held low without it, the bus is reset when it runs out*/
+  wire->setWireTimeout(DS1307_I2C_TIMEOUT_US, true);
+#endif
+}
+
+/*function to return a free running monotonic microsecond counter, used by DS1307_now*/
+uint32_t time_tick_us()
+{
+  return micros();
+}
+
+/*function to return a free running monotonic millisecond counter, ages the DS1307_now anchor past
+  the wrap of time_tick_us*/
+uint32_t time_tick_ms()
 {
-  Wire.begin();
-  Wire.setClock(I2C_SPEED);
+  return millis();
 }
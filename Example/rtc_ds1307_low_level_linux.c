@@ -0,0 +1,174 @@
+/*ds1307 low level api - Reza Ebrahimi v1.0*/
+/*adapted low level api for linux i2c-dev (/dev/i2c-N)*/
+#define _POSIX_C_SOURCE 199309L
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_low_level_linux.h"
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#ifndef I2C_DEVICE_PATH
+#define I2C_DEVICE_PATH       "/dev/i2c-1"        /*bus of handles with a NULL bus, can be overridden from the compiler command line*/
+#endif
+#define I2C_BUFFER_LENGTH     256        /*register address plus the longest burst a uint8_t length can ask for*/
+
+#define I2C_BUS(bus)          ((bus) ? (struct ds1307_linux_bus *)(bus) : &i2c_default_bus)
+
+static struct ds1307_linux_bus i2c_default_bus = DS1307_LINUX_BUS(I2C_DEVICE_PATH);        /*used by handles with a NULL bus*/
+
+/*internal function, fallback for smbus-only adapters. transfers at most I2C_SMBUS_BLOCK_MAX bytes per call*/
+static uint8_t time_i2c_smbus_block(struct ds1307_linux_bus *i2c_bus, uint8_t device_address, uint8_t read_write, uint8_t register_address, uint8_t *data_array, uint8_t data_length)
+{
+  union i2c_smbus_data smbus_data;
+  struct i2c_smbus_ioctl_data smbus_packet;
+  uint8_t chunk_length;
+  if (ioctl(i2c_bus->file, I2C_SLAVE, device_address) < 0)
+    return OPERATION_FAILED;
+  while (data_length)
+  {
+    chunk_length = (data_length > I2C_SMBUS_BLOCK_MAX) ? I2C_SMBUS_BLOCK_MAX : data_length;
+    smbus_data.block[0] = chunk_length;
+    if (read_write == I2C_SMBUS_WRITE)
+      for (uint8_t index = 0; index < chunk_length; index++)
+        smbus_data.block[index + 1] = data_array[index];
+    smbus_packet.read_write = read_write;
+    smbus_packet.command = register_address;
+    smbus_packet.size = I2C_SMBUS_I2C_BLOCK_DATA;
+    smbus_packet.data = &smbus_data;
+    if (ioctl(i2c_bus->file, I2C_SMBUS, &smbus_packet) < 0)
+      return OPERATION_FAILED;
+    if (read_write == I2C_SMBUS_READ)
+      for (uint8_t index = 0; index < chunk_length; index++)
+        data_array[index] = smbus_data.block[index + 1];
+    register_address += chunk_length;
+    data_array += chunk_length;
+    data_length -= chunk_length;
+  }
+  return OPERATION_DONE;
+}
+
+/*function to transmit one byte of data to register_address on ds1307 (device_address: 0X68)*/
+uint8_t time_i2c_write_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+{
+  return time_i2c_write_multi(bus, device_address, register_address, data_byte, 1);
+}
+
+/*function to transmit an array of data to device_address, starting from start_register_address.
+  register address and data leave in one i2c message, one ioctl. the ioctl fails with EREMOTEIO on a
+  NACK and ETIMEDOUT once the adapter timeout set in DS1307_I2C_init runs out*/
+uint8_t time_i2c_write_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  struct ds1307_linux_bus *i2c_bus = I2C_BUS(bus);
+  uint8_t buffer[I2C_BUFFER_LENGTH];
+  struct i2c_msg message;
+  struct i2c_rdwr_ioctl_data packet;
+  if (!i2c_bus->plain_transfers)
+  {
+    return time_i2c_smbus_block(i2c_bus, device_address, I2C_SMBUS_WRITE, start_register_address, data_array, data_length);
+  }
+  buffer[0] = start_register_address;
+  for (uint8_t index = 0; index < data_length; index++)
+    buffer[index + 1] = data_array[index];
+  message.addr = device_address;
+  message.flags = 0;
+  message.len = data_length + 1;
+  message.buf = buffer;
+  packet.msgs = &message;
+  packet.nmsgs = 1;
+  if (ioctl(i2c_bus->file, I2C_RDWR, &packet) < 0)
+    return OPERATION_FAILED;
+  return OPERATION_DONE;
+}
+
+/*function to read one byte of data from register_address on ds1307*/
+uint8_t time_i2c_read_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+{
+  return time_i2c_read_multi(bus, device_address, register_address, data_byte, 1);
+}
+
+/*function to read an array of data from device_address. the register address write and the read
+  are two messages of one I2C_RDWR ioctl, joined by a repeated start*/
+uint8_t time_i2c_read_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  struct ds1307_linux_bus *i2c_bus = I2C_BUS(bus);
+  struct i2c_msg message[2];
+  struct i2c_rdwr_ioctl_data packet;
+  if (!i2c_bus->plain_transfers)
+  {
+    return time_i2c_smbus_block(i2c_bus, device_address, I2C_SMBUS_READ, start_register_address, data_array, data_length);
+  }
+  message[0].addr = device_address;
+  message[0].flags = 0;
+  message[0].len = 1;
+  message[0].buf = &start_register_address;
+  message[1].addr = device_address;
+  message[1].flags = I2C_M_RD;
+  message[1].len = data_length;
+  message[1].buf = data_array;
+  packet.msgs = message;
+  packet.nmsgs = 2;
+  if (ioctl(i2c_bus->file, I2C_RDWR, &packet) < 0)
+    return OPERATION_FAILED;
+  return OPERATION_DONE;
+}
+
+/*function to free the bus after a failed transfer. the adapter drivers recover a bus held low by
+  themselves (i2c_recover_bus on a timeout) and i2c-dev gives no access to the lines, so nothing is
+  left to do here*/
+void time_i2c_recover(void *bus)
+{
+  (void)bus;
+}
+
+#if DS1307_ASYNC
+/*function to start a transaction on the bus and return, DS1307_async_complete(transaction->rtc, status)
+  is called once it is over. the ioctl blocks the calling thread, so the transfer is made
+  here and completed at once. run the async calls from a worker thread to keep another one free*/
+void time_i2c_submit(void *bus, struct ds1307_transaction *transaction)
+{
+  uint8_t status;
+  if (transaction->direction == DS1307_TRANSACTION_WRITE)
+    status = time_i2c_write_multi(bus, transaction->device_address, transaction->register_address, transaction->data_array, transaction->data_length);
+  else
+    status = time_i2c_read_multi(bus, transaction->device_address, transaction->register_address, transaction->data_array, transaction->data_length);
+  DS1307_async_complete(transaction->rtc, status);
+}
+#endif
+
+/*function to open the i2c bus once, bus speed is set by the device tree of the adapter. handles
+  sharing a struct ds1307_linux_bus share its file*/
+void DS1307_I2C_init(void *bus)
+{
+  struct ds1307_linux_bus *i2c_bus = I2C_BUS(bus);
+  unsigned long functionality = 0;
+  if (i2c_bus->file >= 0)
+    return;
+  i2c_bus->file = open(i2c_bus->device_path, O_RDWR);
+  if (i2c_bus->file < 0)
+    return;
+  ioctl(i2c_bus->file, I2C_FUNCS, &functionality);
+  i2c_bus->plain_transfers = (functionality & I2C_FUNC_I2C) ? 1 : 0;
+  /*the driver retries itself, so one failure reaches the driver at once. timeout is in 10 ms units*/
+  ioctl(i2c_bus->file, I2C_RETRIES, 0);
+  ioctl(i2c_bus->file, I2C_TIMEOUT, (DS1307_I2C_TIMEOUT_US + 9999) / 10000);
+}
+
+/*function to return a free running monotonic microsecond counter, used by DS1307_now*/
+uint32_t time_tick_us()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000 + (now.tv_nsec / 1000));
+}
+
+/*function to return a free running monotonic millisecond counter, ages the DS1307_now anchor past
+  the wrap of time_tick_us*/
+uint32_t time_tick_ms()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000 + (now.tv_nsec / 1000000));
+}
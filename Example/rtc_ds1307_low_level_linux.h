@@ -0,0 +1,17 @@
+/*ds1307 linux low level header file - Reza Ebrahimi v1.0*/
+/*bus handle of rtc_ds1307_low_level_linux.c, one per /dev/i2c-N*/
+#ifndef RTC_DS1307_LOW_LEVEL_LINUX_H
+#define RTC_DS1307_LOW_LEVEL_LINUX_H
+
+#include <stdint.h>
+
+/*give a pointer to one of these to DS1307_handle_init as bus. NULL uses a default bus on I2C_DEVICE_PATH*/
+struct ds1307_linux_bus {
+  const char *device_path;        /*for example "/dev/i2c-1"*/
+  int file;        /*opened by DS1307_I2C_init, kept open for every transaction*/
+  uint8_t plain_transfers;        /*adapter supports I2C_RDWR, otherwise (i2c-stub) smbus i2c block transfers are used*/
+};
+
+#define DS1307_LINUX_BUS(device_path)         {device_path, -1, 0}
+
+#endif
@@ -0,0 +1,371 @@
+/*ds1307 low level api - Reza Ebrahimi v1.0*/
+/*software ds1307 behind the low level api, to run and measure the driver on a host without hardware.
+  every transaction is charged its bus time at the simulated bus speed, and the simulated clock only
+  moves forward by bus time, DS1307_sim_advance_us and the cpu time of time_tick_us. single threaded, like the hardware it stands for.
+  time_i2c_submit does not block: the transfer runs at once and DS1307_async_complete is called from
+  DS1307_sim_advance_us when the simulated time reaches its STOP, as a bus interrupt would*/
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_sim.h"
+
+#define SIM_NS_PER_SECOND       1000000000ULL
+#define SIM_BIT_START           1        /*START, repeated START and STOP are charged one bit time each*/
+#define SIM_BIT_STOP            1
+#define SIM_NS_PER_TICK_READ    1000        /*cpu time of one time_tick_us call, so a busy wait on it comes to an end*/
+#define SIM_RECOVER_BITS        10        /*9 SCL pulses and a STOP of time_i2c_recover*/
+
+#define SIM_CHIP(bus)           ((bus) ? (struct ds1307_sim *)(bus) : &sim_default_chip)
+
+static struct ds1307_sim sim_default_chip;        /*used by handles with a NULL bus*/
+static uint64_t sim_time_ns;        /*simulated time, shared by all chips, time_tick_us runs on it*/
+static struct ds1307_sim *sim_chip_list;        /*every powered chip*/
+static const uint8_t sim_days_in_month[] = {0X31, 0X28, 0X31, 0X30, 0X31, 0X30, 0X31, 0X31, 0X30, 0X31, 0X30, 0X31};
+
+/*internal function, adds one to a bcd byte*/
+static uint8_t sim_bcd_increment(uint8_t value)
+{
+  if ((value & 0X0F) == 0X09)
+    return (value & 0XF0) + 0X10;
+  return value + 1;
+}
+
+/*internal function, what the ds1307 countdown chain does once per second. returns once a carry stops*/
+static void sim_second_tick(struct ds1307_sim *sim)
+{
+  uint8_t *sim_register = sim->sim_register;
+  uint8_t hour, month_length;
+  if ((sim_register[DS1307_REGISTER_SECONDS] & 0X7F) != 0X59)
+  {
+    sim_register[DS1307_REGISTER_SECONDS] = (sim_register[DS1307_REGISTER_SECONDS] & 0X80) | sim_bcd_increment(sim_register[DS1307_REGISTER_SECONDS] & 0X7F);
+    return;
+  }
+  sim_register[DS1307_REGISTER_SECONDS] &= 0X80;
+  if (sim_register[DS1307_REGISTER_MINUTES] != 0X59)
+  {
+    sim_register[DS1307_REGISTER_MINUTES] = sim_bcd_increment(sim_register[DS1307_REGISTER_MINUTES]);
+    return;
+  }
+  sim_register[DS1307_REGISTER_MINUTES] = 0X00;
+  if (sim_register[DS1307_REGISTER_HOURS] & (1 << DS1307_BIT_SETTING_AMPM))
+  {
+    /*12 hour mode, bit 5 is PM. 11 -> 12 flips AM/PM, 12 -> 1, a new day starts at 12 AM*/
+    hour = sim_register[DS1307_REGISTER_HOURS] & 0X1F;
+    if (hour == 0X11)
+    {
+      sim_register[DS1307_REGISTER_HOURS] = (sim_register[DS1307_REGISTER_HOURS] ^ 0X20) & 0XE0;
+      sim_register[DS1307_REGISTER_HOURS] |= 0X12;
+      if (sim_register[DS1307_REGISTER_HOURS] & 0X20)
+        return;
+    }
+    else
+    {
+      sim_register[DS1307_REGISTER_HOURS] = (sim_register[DS1307_REGISTER_HOURS] & 0XE0) | ((hour == 0X12) ? 0X01 : sim_bcd_increment(hour));
+      return;
+    }
+  }
+  else
+  {
+    hour = sim_register[DS1307_REGISTER_HOURS] & 0X3F;
+    if (hour != 0X23)
+    {
+      sim_register[DS1307_REGISTER_HOURS] = (sim_register[DS1307_REGISTER_HOURS] & 0XC0) | sim_bcd_increment(hour);
+      return;
+    }
+    sim_register[DS1307_REGISTER_HOURS] &= 0XC0;
+  }
+  sim_register[DS1307_REGISTER_DAY_OF_WEEK] = (sim_register[DS1307_REGISTER_DAY_OF_WEEK] >= 0X07) ? 0X01 : (sim_register[DS1307_REGISTER_DAY_OF_WEEK] + 1);
+  month_length = sim_days_in_month[((sim_register[DS1307_REGISTER_MONTH] >> 4) * 10 + (sim_register[DS1307_REGISTER_MONTH] & 0X0F) - 1) % 12];
+  /*year register is 2000 to 2099, every year divisible by 4 is leap (bcd 00, 04, ..., 96)*/
+  if ((sim_register[DS1307_REGISTER_MONTH] == 0X02) && !((((sim_register[DS1307_REGISTER_YEAR] >> 4) * 10) + (sim_register[DS1307_REGISTER_YEAR] & 0X0F)) & 0X03))
+    month_length = 0X29;
+  if (sim_register[DS1307_REGISTER_DATE] < month_length)
+  {
+    sim_register[DS1307_REGISTER_DATE] = sim_bcd_increment(sim_register[DS1307_REGISTER_DATE]);
+    return;
+  }
+  sim_register[DS1307_REGISTER_DATE] = 0X01;
+  if (sim_register[DS1307_REGISTER_MONTH] != 0X12)
+  {
+    sim_register[DS1307_REGISTER_MONTH] = sim_bcd_increment(sim_register[DS1307_REGISTER_MONTH]);
+    return;
+  }
+  sim_register[DS1307_REGISTER_MONTH] = 0X01;
+  sim_register[DS1307_REGISTER_YEAR] = (sim_register[DS1307_REGISTER_YEAR] == 0X99) ? 0X00 : sim_bcd_increment(sim_register[DS1307_REGISTER_YEAR]);
+}
+
+/*internal function, brings a chip up to the shared simulated time. the oscillator only counts while CH is clear*/
+static void sim_update(struct ds1307_sim *sim)
+{
+  uint64_t elapsed_time;
+  /*a SECONDS write restarts the countdown at its ACK, which can be later than now*/
+  if (sim_time_ns <= sim->sim_updated_ns)
+    return;
+  elapsed_time = sim_time_ns - sim->sim_updated_ns;
+  sim->sim_updated_ns = sim_time_ns;
+  if (sim->sim_register[DS1307_REGISTER_SECONDS] & (1 << DS1307_BIT_SETTING_CH))
+    return;
+  sim->sim_countdown_ns += elapsed_time;
+  while (sim->sim_countdown_ns >= SIM_NS_PER_SECOND)
+  {
+    sim->sim_countdown_ns -= SIM_NS_PER_SECOND;
+    sim_second_tick(sim);
+  }
+}
+
+/*internal function, time of bit_count bits at the bus speed of a chip*/
+static uint64_t sim_bit_time(struct ds1307_sim *sim, uint32_t bit_count)
+{
+  return ((uint64_t)bit_count * SIM_NS_PER_SECOND) / (sim->sim_bus_speed ? sim->sim_bus_speed : DS1307_SIM_BUS_STANDARD);
+}
+
+/*internal function, charges a transaction of bit_count bit times to the bus of a chip and returns its
+  bus time. a blocking transfer lets the simulated time pass, a submitted one does not*/
+static uint64_t sim_transaction(struct ds1307_sim *sim, uint32_t bit_count)
+{
+  uint64_t bus_time = sim_bit_time(sim, bit_count);
+  sim->sim_stats.transactions++;
+  sim->sim_stats.bus_time_ns += bus_time;
+  return bus_time;
+}
+
+/*internal function, one byte written by the master at the register pointer, acknowledged at ack_time*/
+static void sim_write_byte(struct ds1307_sim *sim, uint8_t data_byte, uint64_t ack_time)
+{
+  /*writing SECONDS resets the countdown chain on its ACK, the next second is a full second later*/
+  if (sim->sim_register_pointer == DS1307_REGISTER_SECONDS)
+  {
+    sim->sim_countdown_ns = 0;
+    sim->sim_updated_ns = ack_time;
+  }
+  sim->sim_register[sim->sim_register_pointer] = data_byte;
+  sim->sim_register_pointer = (sim->sim_register_pointer + 1) & (DS1307_SIM_REGISTER_FILE_SIZE - 1);
+}
+
+/*internal function, whether the next transaction of a chip is NACKed. a NACK comes on the address
+  byte, it costs START, address and STOP and leaves the chip untouched*/
+static uint8_t sim_nack(struct ds1307_sim *sim, uint8_t device_address, uint64_t *bus_time)
+{
+  if ((device_address == DS1307_I2C_ADDRESS) && !sim->sim_fail_count)
+    return 0;
+  if (sim->sim_fail_count)
+    sim->sim_fail_count--;
+  sim->sim_stats.failed_transactions++;
+  *bus_time = sim_transaction(sim, SIM_BIT_START + DS1307_SIM_BITS_PER_BYTE + SIM_BIT_STOP);
+  return 1;
+}
+
+/*internal function, START, address, register pointer, data bytes, STOP. returns the bus time*/
+static uint64_t sim_write(struct ds1307_sim *sim, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  sim_update(sim);
+  sim->sim_register_pointer = start_register_address & (DS1307_SIM_REGISTER_FILE_SIZE - 1);
+  for (uint8_t index = 0; index < data_length; index++)
+    sim_write_byte(sim, data_array[index], sim_time_ns + sim_bit_time(sim, SIM_BIT_START + ((3 + index) * DS1307_SIM_BITS_PER_BYTE)));
+  sim->sim_stats.bytes_written += data_length + 1;
+  return sim_transaction(sim, SIM_BIT_START + ((2 + data_length) * DS1307_SIM_BITS_PER_BYTE) + SIM_BIT_STOP);
+}
+
+/*internal function, START, address, register pointer, repeated START, address, data bytes, STOP.
+  the data comes from the state at START, as the user buffers of ds1307 are latched there. returns the bus time*/
+static uint64_t sim_read(struct ds1307_sim *sim, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  sim_update(sim);
+  sim->sim_register_pointer = start_register_address & (DS1307_SIM_REGISTER_FILE_SIZE - 1);
+  for (uint8_t index = 0; index < data_length; index++)
+  {
+    data_array[index] = sim->sim_register[sim->sim_register_pointer];
+    sim->sim_register_pointer = (sim->sim_register_pointer + 1) & (DS1307_SIM_REGISTER_FILE_SIZE - 1);
+  }
+  sim->sim_stats.bytes_written += 1;
+  sim->sim_stats.bytes_read += data_length;
+  return sim_transaction(sim, (2 * SIM_BIT_START) + ((3 + data_length) * DS1307_SIM_BITS_PER_BYTE) + SIM_BIT_STOP);
+}
+
+/*puts a simulated ds1307 in its first power on state: 01/01/00 01 00:00:00 with CH set, RAM cleared.
+  NULL is the default chip*/
+void DS1307_sim_power_on(struct ds1307_sim *sim)
+{
+  sim = SIM_CHIP(sim);
+  if (!sim->sim_powered)
+  {
+    sim->sim_next = sim_chip_list;
+    sim_chip_list = sim;
+  }
+  sim->sim_async_transaction = 0;
+  for (uint8_t index = 0; index < DS1307_SIM_REGISTER_FILE_SIZE; index++)
+    sim->sim_register[index] = 0X00;
+  sim->sim_register[DS1307_REGISTER_SECONDS] = (1 << DS1307_BIT_SETTING_CH);
+  sim->sim_register[DS1307_REGISTER_DAY_OF_WEEK] = 0X01;
+  sim->sim_register[DS1307_REGISTER_DATE] = 0X01;
+  sim->sim_register[DS1307_REGISTER_MONTH] = 0X01;
+  sim->sim_register[DS1307_REGISTER_CONTROL] = (1 << DS1307_BIT_SETTING_RS1) | (1 << DS1307_BIT_SETTING_RS0);
+  sim->sim_register_pointer = 0;
+  sim->sim_countdown_ns = 0;
+  sim->sim_updated_ns = sim_time_ns;
+  sim->sim_powered = 1;
+}
+
+/*sets the simulated scl frequency of a chip in Hz, DS1307_SIM_BUS_STANDARD or DS1307_SIM_BUS_FAST*/
+void DS1307_sim_bus_speed(struct ds1307_sim *sim, uint32_t bus_speed)
+{
+  SIM_CHIP(sim)->sim_bus_speed = bus_speed;
+}
+
+/*lets time pass for every chip without cpu bus traffic, as the mcu would between driver calls.
+  submitted transactions that end meanwhile are completed in order of their STOP*/
+void DS1307_sim_advance_us(uint32_t microseconds)
+{
+  uint64_t target_time = sim_time_ns + (uint64_t)microseconds * 1000;
+#if DS1307_ASYNC
+  struct ds1307_sim *sim, *next_done;
+  struct ds1307_transaction *transaction;
+  for (;;)
+  {
+    next_done = 0;
+    for (sim = sim_chip_list; sim; sim = sim->sim_next)
+      if (sim->sim_async_transaction && (sim->sim_async_done_ns <= target_time) && (!next_done || (sim->sim_async_done_ns < next_done->sim_async_done_ns)))
+        next_done = sim;
+    if (!next_done)
+      break;
+    sim_time_ns = next_done->sim_async_done_ns;
+    transaction = next_done->sim_async_transaction;
+    next_done->sim_async_transaction = 0;
+    DS1307_async_complete(transaction->rtc, next_done->sim_async_status);
+  }
+#endif
+  sim_time_ns = target_time;
+}
+
+/*makes the next fail_count transactions of a chip fail with a NACK, as a chip off the bus or in the
+  middle of a power loss would. 0 stops it*/
+void DS1307_sim_fail(struct ds1307_sim *sim, uint32_t fail_count)
+{
+  SIM_CHIP(sim)->sim_fail_count = fail_count;
+}
+
+/*makes the next lose_count submitted transactions of a chip run on the bus but never complete, as a
+  missed i2c interrupt would. 0 stops it*/
+void DS1307_sim_lose(struct ds1307_sim *sim, uint32_t lose_count)
+{
+  SIM_CHIP(sim)->sim_lose_count = lose_count;
+}
+
+/*copies the bus counters of a chip collected since the last DS1307_sim_stats_reset*/
+void DS1307_sim_stats(struct ds1307_sim *sim, struct ds1307_sim_stats *stats)
+{
+  *stats = SIM_CHIP(sim)->sim_stats;
+}
+
+void DS1307_sim_stats_reset(struct ds1307_sim *sim)
+{
+  sim = SIM_CHIP(sim);
+  sim->sim_stats.transactions = 0;
+  sim->sim_stats.bytes_read = 0;
+  sim->sim_stats.bytes_written = 0;
+  sim->sim_stats.bus_time_ns = 0;
+  sim->sim_stats.failed_transactions = 0;
+  sim->sim_stats.recoveries = 0;
+}
+
+/*direct access to the 64 byte register file of a chip, up to date with the simulated time. no bus time is charged*/
+uint8_t *DS1307_sim_registers(struct ds1307_sim *sim)
+{
+  sim = SIM_CHIP(sim);
+  sim_update(sim);
+  return sim->sim_register;
+}
+
+/*function to transmit one byte of data to register_address on ds1307*/
+uint8_t time_i2c_write_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+{
+  return time_i2c_write_multi(bus, device_address, register_address, data_byte, 1);
+}
+
+/*function to transmit an array of data to device_address, starting from start_register_address*/
+uint8_t time_i2c_write_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  uint64_t bus_time;
+  if (sim_nack(SIM_CHIP(bus), device_address, &bus_time))
+  {
+    sim_time_ns += bus_time;
+    return OPERATION_FAILED;
+  }
+  sim_time_ns += sim_write(SIM_CHIP(bus), start_register_address, data_array, data_length);
+  return OPERATION_DONE;
+}
+
+/*function to read one byte of data from register_address on ds1307*/
+uint8_t time_i2c_read_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+{
+  return time_i2c_read_multi(bus, device_address, register_address, data_byte, 1);
+}
+
+/*function to read an array of data from device_address*/
+uint8_t time_i2c_read_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  uint64_t bus_time;
+  if (sim_nack(SIM_CHIP(bus), device_address, &bus_time))
+  {
+    sim_time_ns += bus_time;
+    return OPERATION_FAILED;
+  }
+  sim_time_ns += sim_read(SIM_CHIP(bus), start_register_address, data_array, data_length);
+  return OPERATION_DONE;
+}
+
+/*function to free the bus after a failed transfer, charged as 9 SCL pulses and a STOP. a submitted
+  transaction still on the bus is dropped*/
+void time_i2c_recover(void *bus)
+{
+  struct ds1307_sim *sim = SIM_CHIP(bus);
+  sim->sim_async_transaction = 0;
+  sim->sim_stats.recoveries++;
+  sim->sim_stats.bus_time_ns += sim_bit_time(sim, SIM_RECOVER_BITS);
+  sim_time_ns += sim_bit_time(sim, SIM_RECOVER_BITS);
+}
+
+#if DS1307_ASYNC
+/*function to start a transaction without waiting for it. the cpu time does not move, the transaction
+  is completed by DS1307_sim_advance_us once its bus time has passed*/
+void time_i2c_submit(void *bus, struct ds1307_transaction *transaction)
+{
+  struct ds1307_sim *sim = SIM_CHIP(bus);
+  uint64_t bus_time;
+  sim->sim_async_status = OPERATION_FAILED;
+  if (!sim_nack(sim, transaction->device_address, &bus_time))
+  {
+    if (transaction->direction == DS1307_TRANSACTION_WRITE)
+      bus_time = sim_write(sim, transaction->register_address, transaction->data_array, transaction->data_length);
+    else
+      bus_time = sim_read(sim, transaction->register_address, transaction->data_array, transaction->data_length);
+    sim->sim_async_status = OPERATION_DONE;
+  }
+  if (sim->sim_lose_count)
+  {
+    sim->sim_lose_count--;
+    return;
+  }
+  sim->sim_async_transaction = transaction;
+  sim->sim_async_done_ns = sim_time_ns + bus_time;
+}
+#endif
+
+/*the simulated chip powers on with the first init, a later init keeps its state like a battery backed ds1307*/
+void DS1307_I2C_init(void *bus)
+{
+  if (!SIM_CHIP(bus)->sim_powered)
+    DS1307_sim_power_on(bus);
+}
+
+/*function to return a free running monotonic microsecond counter, used by DS1307_now*/
+uint32_t time_tick_us()
+{
+  sim_time_ns += SIM_NS_PER_TICK_READ;
+  return (uint32_t)(sim_time_ns / 1000);
+}
+
+/*function to return a free running monotonic millisecond counter, ages the DS1307_now anchor past
+  the wrap of time_tick_us*/
+uint32_t time_tick_ms()
+{
+  return (uint32_t)(sim_time_ns / 1000000);
+}
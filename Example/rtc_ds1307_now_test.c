@@ -0,0 +1,71 @@
+/*ds1307 DS1307_now wrap test - Reza Ebrahimi v1.0*/
+/*host program for DS1307_now and DS1307_now_edge across the 71.6 minute wrap of time_tick_us, on the
+  simulator (time only moves when the program says so):
+    cc -O2 -I. -IExample -o now_test Example/rtc_ds1307_now_test.c rtc_ds1307.c Example/rtc_ds1307_low_level_sim.c && ./now_test
+  the handle is anchored, left alone for longer than the wrap and then compared with a read of the
+  chip: with a free anchor, with an anchor locked to the 1hz edge whose interrupts stop for the idle
+  time, and after an idle time of exactly one wrap, where time_tick_us comes back to the same value*/
+#include <stdio.h>
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_sim.h"
+
+#define TEST_WRAP_US            4294967296ULL        /*period of time_tick_us*/
+
+static ds1307_t test_rtc;
+static uint8_t test_start_time[7] = {0, 0, 12, 2, 1, 1, 24};        /*12:00:00 monday 2024-01-01*/
+
+/*DS1307_sim_advance_us takes 32 bits, longer idle times are cut into minutes*/
+static void test_idle_us(uint64_t microseconds)
+{
+  while (microseconds > 60000000ULL)
+  {
+    DS1307_sim_advance_us(60000000UL);
+    microseconds -= 60000000ULL;
+  }
+  DS1307_sim_advance_us((uint32_t)microseconds);
+}
+
+/*returns 1 if DS1307_now and the chip disagree, a read may land on the next second*/
+static uint32_t test_compare(const char *name)
+{
+  uint8_t now_array[7], chip_array[7];
+  uint8_t now_status = DS1307_now(&test_rtc, now_array);
+  uint8_t chip_status = DS1307_read(&test_rtc, TIME, chip_array);
+  uint8_t match = (now_status == OPERATION_DONE) && (chip_status == OPERATION_DONE);
+  for (uint8_t index = 1; index < 7; index++)
+    match = match && (now_array[index] == chip_array[index]);
+  match = match && ((now_array[0] == chip_array[0]) || (((now_array[0] + 1) % 60) == chip_array[0]));
+  printf("  %-40s now %02u:%02u:%02u chip %02u:%02u:%02u %s\n", name, now_array[2], now_array[1], now_array[0], chip_array[2], chip_array[1], chip_array[0], match ? "ok" : "FAILED");
+  return match ? 0 : 1;
+}
+
+int main(void)
+{
+  uint32_t errors = 0;
+  DS1307_handle_init(&test_rtc, 0, DS1307_I2C_ADDRESS);
+  DS1307_init(&test_rtc, test_start_time, CLOCK_RUN, FORCE_RESET);
+  /*free anchor taken 300 ms into a second, then 72 minutes without a call*/
+  DS1307_sim_advance_us(300000);
+  errors += test_compare("anchored");
+  test_idle_us(72 * 60000000ULL);
+  errors += test_compare("72 minutes idle");
+  /*exactly one wrap: time_tick_us is back where the anchor was taken*/
+  test_idle_us(TEST_WRAP_US);
+  errors += test_compare("one time_tick_us wrap idle");
+  /*locked anchor: a set restarts the countdown, so the edges come a whole number of seconds later*/
+  DS1307_set(&test_rtc, TIME, test_start_time);
+  DS1307_sim_advance_us(400000);
+  errors += test_compare("anchored after set");
+  DS1307_sim_advance_us(600000 + 30);
+  DS1307_now_edge(&test_rtc);
+  errors += test_compare("edge locked");
+  /*the interrupt stops for 72 minutes and 10 seconds and comes back on an edge*/
+  test_idle_us((72 * 60000000ULL) + 10000000ULL - 30);
+  DS1307_now_edge(&test_rtc);
+  errors += test_compare("edge after 72 minutes without edges");
+  /*locked anchor left alone for 72 minutes, read without an edge*/
+  test_idle_us(72 * 60000000ULL);
+  errors += test_compare("edge locked, 72 minutes idle");
+  printf("DS1307_now across the time_tick_us wrap: %s (%u mismatches)\n", errors ? "FAILED" : "ok", errors);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*ds1307 shared memory time service - Reza Ebrahimi v1.0*/
+/*writer side (DS1307_shm_create, DS1307_shm_publish) for the daemon and reader side for every other
+  process. the page is guarded by a seqlock: the daemon never waits for readers and readers never
+  write to the page, so any number of them scale without sharing a written cache line*/
+#define _POSIX_C_SOURCE 200809L
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_shm.h"
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define SHM_LOAD(field)                 __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define SHM_STORE(field, value)         __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
+/*creates (or reopens) the shared page for the daemon, readable by everyone. NULL on failure*/
+struct ds1307_shm_page *DS1307_shm_create(const char *name)
+{
+  struct ds1307_shm_page *page;
+  int file = shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (file < 0)
+    return NULL;
+  if (ftruncate(file, sizeof(struct ds1307_shm_page)) < 0)
+  {
+    close(file);
+    return NULL;
+  }
+  page = mmap(NULL, sizeof(struct ds1307_shm_page), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  close(file);
+  if (page == MAP_FAILED)
+    return NULL;
+  /*an odd sequence left by a daemon that died while publishing is made even again*/
+  if (SHM_LOAD(page->sequence) & 0X01)
+    SHM_STORE(page->sequence, SHM_LOAD(page->sequence) + 1);
+  __atomic_store_n(&page->magic, DS1307_SHM_MAGIC, __ATOMIC_RELEASE);
+  return page;
+}
+
+/*writes a new sample into the page, called by the daemon only (one writer)*/
+void DS1307_shm_publish(struct ds1307_shm_page *page, uint32_t epoch, uint8_t run_state, int64_t anchor_ns, int64_t published_ns)
+{
+  uint32_t sequence = SHM_LOAD(page->sequence);
+  SHM_STORE(page->sequence, sequence + 1);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  SHM_STORE(page->epoch, epoch);
+  SHM_STORE(page->run_state, run_state);
+  SHM_STORE(page->anchor_ns, anchor_ns);
+  SHM_STORE(page->published_ns, published_ns);
+  SHM_STORE(page->publish_count, SHM_LOAD(page->publish_count) + 1);
+  __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/*maps the page read only, NULL if the daemon has not created it yet*/
+const struct ds1307_shm_page *DS1307_shm_attach(const char *name)
+{
+  const struct ds1307_shm_page *page;
+  int file = shm_open(name, O_RDONLY, 0);
+  if (file < 0)
+    return NULL;
+  page = mmap(NULL, sizeof(struct ds1307_shm_page), PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (page == MAP_FAILED)
+    return NULL;
+  if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != DS1307_SHM_MAGIC)
+  {
+    munmap((void *)page, sizeof(struct ds1307_shm_page));
+    return NULL;
+  }
+  return page;
+}
+
+void DS1307_shm_detach(const struct ds1307_shm_page *page)
+{
+  munmap((void *)page, sizeof(struct ds1307_shm_page));
+}
+
+/*copies the page between two equal and even reads of its sequence. fails if the daemon has not
+  published yet, or if every one of DS1307_SHM_RETRIES copies collided with a publish*/
+uint8_t DS1307_shm_sample(const struct ds1307_shm_page *page, struct ds1307_shm_sample *sample)
+{
+  uint32_t sequence;
+  for (uint8_t retry = 0; retry < DS1307_SHM_RETRIES; retry++)
+  {
+    sequence = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+    if ((sequence == 0) || (sequence & 0X01))
+      continue;
+    sample->epoch = SHM_LOAD(page->epoch);
+    sample->run_state = SHM_LOAD(page->run_state);
+    sample->anchor_ns = SHM_LOAD(page->anchor_ns);
+    sample->published_ns = SHM_LOAD(page->published_ns);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (SHM_LOAD(page->sequence) == sequence)
+      return OPERATION_DONE;
+  }
+  return OPERATION_FAILED;
+}
+
+/*current unix time as whole seconds and nanoseconds, extrapolated from the last publish with the
+  monotonic clock. fails on a halted clock, or when the daemon has not published for DS1307_SHM_STALE_MS*/
+uint8_t DS1307_shm_now(const struct ds1307_shm_page *page, uint32_t *epoch, uint32_t *nanoseconds)
+{
+  struct ds1307_shm_sample sample;
+  int64_t now_ns, elapsed_ns;
+  if (DS1307_shm_sample(page, &sample) != OPERATION_DONE)
+    return OPERATION_FAILED;
+  now_ns = DS1307_shm_monotonic_ns();
+  if ((sample.run_state != DS1307_IS_RUNNING) || ((now_ns - sample.published_ns) > (DS1307_SHM_STALE_MS * 1000000LL)))
+    return OPERATION_FAILED;
+  elapsed_ns = now_ns - sample.anchor_ns;
+  if (elapsed_ns < 0)
+    elapsed_ns = 0;
+  *epoch = sample.epoch + (uint32_t)(elapsed_ns / 1000000000LL);
+  *nanoseconds = (uint32_t)(elapsed_ns % 1000000000LL);
+  return OPERATION_DONE;
+}
+
+int64_t DS1307_shm_monotonic_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((int64_t)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
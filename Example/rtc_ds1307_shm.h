@@ -0,0 +1,54 @@
+/*ds1307 shared memory time service header file - Reza Ebrahimi v1.0*/
+/*one daemon (rtc_ds1307_shm_daemon.c) owns the bus and publishes the time into a shared page, any
+  number of local processes read it with DS1307_shm_now: no bus traffic, no lock and no syscall
+  (clock_gettime(CLOCK_MONOTONIC) is served by the vdso)*/
+#ifndef RTC_DS1307_SHM_H
+#define RTC_DS1307_SHM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DS1307_SHM_NAME                       "/ds1307_time"        /*shm_open name of the page*/
+#define DS1307_SHM_MAGIC                      0X44533037        /*"DS07", written once the page is set up*/
+#define DS1307_SHM_RETRIES                    64        /*reads that may collide with the daemon before DS1307_shm_now gives up*/
+#ifndef DS1307_SHM_STALE_MS
+#define DS1307_SHM_STALE_MS                   300000        /*age of the last publish after which readers fail, the daemon is taken as gone*/
+#endif
+
+/*the shared page. sequence is odd while the daemon writes, a reader copies the fields between two
+  equal and even reads of it (seqlock). epoch is the ds1307 unix time that began at anchor_ns, a
+  CLOCK_MONOTONIC time, so the time now is epoch + (monotonic now - anchor_ns)*/
+struct ds1307_shm_page {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t epoch;
+  uint8_t run_state;        /*DS1307_IS_RUNNING, readers fail on a halted clock*/
+  int64_t anchor_ns;        /*CLOCK_MONOTONIC of the second edge that started epoch*/
+  int64_t published_ns;        /*CLOCK_MONOTONIC of the last publish*/
+  uint32_t publish_count;
+};
+
+/*one consistent copy of the page*/
+struct ds1307_shm_sample {
+  uint32_t epoch;
+  uint8_t run_state;
+  int64_t anchor_ns;
+  int64_t published_ns;
+};
+
+struct ds1307_shm_page *DS1307_shm_create(const char *name);
+void DS1307_shm_publish(struct ds1307_shm_page *page, uint32_t epoch, uint8_t run_state, int64_t anchor_ns, int64_t published_ns);
+const struct ds1307_shm_page *DS1307_shm_attach(const char *name);
+void DS1307_shm_detach(const struct ds1307_shm_page *page);
+uint8_t DS1307_shm_sample(const struct ds1307_shm_page *page, struct ds1307_shm_sample *sample);
+uint8_t DS1307_shm_now(const struct ds1307_shm_page *page, uint32_t *epoch, uint32_t *nanoseconds);
+int64_t DS1307_shm_monotonic_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/*ds1307 shared memory reader benchmark - Reza Ebrahimi v1.0*/
+/*host program for the seqlock of rtc_ds1307_shm.c, no ds1307 needed. a publisher thread takes the
+  place of the daemon and publishes every BENCH_PUBLISH_US into a page of its own, while N reader
+  threads call DS1307_shm_now as fast as they can:
+    cc -O2 -pthread -I. -IExample -o shm_bench Example/rtc_ds1307_shm_bench.c Example/rtc_ds1307_shm.c
+    for readers in 1 2 4 8; do ./shm_bench $readers; done
+  (-lrt on older glibc). arguments are the readers (default 1), the seconds to run (default 2) and the
+  publish period in us (default 20). every publish is self checking: published_ns - anchor_ns is
+  epoch - BENCH_EPOCH_BASE, so every 64th read a reader also takes a DS1307_shm_sample and counts it
+  as torn if the fields do not belong together, and a DS1307_shm_now that goes back counts as well.
+  readers only scale with the cores they get, on one core the total stays flat*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_shm.h"
+
+#define BENCH_SHM_NAME          "/ds1307_time_bench"        /*not DS1307_SHM_NAME, a running daemon is left alone*/
+#define BENCH_READERS_MAX       64
+#define BENCH_EPOCH_BASE        1700000000UL
+#define BENCH_CHECK_EVERY       64        /*reads between two sample checks, a power of 2*/
+#define BENCH_CACHE_LINE        64
+
+/*one per reader, padded so that the counters of two readers never share a cache line*/
+struct bench_reader {
+  pthread_t thread;
+  const struct ds1307_shm_page *page;
+  uint64_t reads;
+  uint64_t failed;
+  uint64_t torn;
+  uint64_t backward;
+  double seconds;
+  char padding[BENCH_CACHE_LINE];
+};
+
+static volatile int bench_stop;
+static struct ds1307_shm_page *bench_page;
+static uint32_t bench_publish_us = 20;
+static uint64_t bench_publishes;
+
+static void *bench_publisher(void *argument)
+{
+  struct timespec next;
+  int64_t now_ns;
+  uint32_t count = 0;
+  (void)argument;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (!__atomic_load_n(&bench_stop, __ATOMIC_RELAXED))
+  {
+    now_ns = DS1307_shm_monotonic_ns();
+    DS1307_shm_publish(bench_page, BENCH_EPOCH_BASE + count, DS1307_IS_RUNNING, now_ns, now_ns + count);
+    count++;
+    next.tv_nsec += bench_publish_us * 1000L;
+    while (next.tv_nsec >= 1000000000L)
+    {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  bench_publishes = count;
+  return NULL;
+}
+
+static void *bench_read(void *argument)
+{
+  struct bench_reader *reader = argument;
+  struct ds1307_shm_sample sample;
+  uint64_t previous_ns = 0, now_ns;
+  uint32_t epoch, nanoseconds;
+  int64_t start_ns = DS1307_shm_monotonic_ns();
+  while (!__atomic_load_n(&bench_stop, __ATOMIC_RELAXED))
+  {
+    if (DS1307_shm_now(reader->page, &epoch, &nanoseconds) != OPERATION_DONE)
+    {
+      reader->failed++;
+      continue;
+    }
+    now_ns = ((uint64_t)epoch * 1000000000ULL) + nanoseconds;
+    if (now_ns < previous_ns)
+      reader->backward++;
+    previous_ns = now_ns;
+    if (!(++reader->reads & (BENCH_CHECK_EVERY - 1)) && (DS1307_shm_sample(reader->page, &sample) == OPERATION_DONE))
+    {
+      if ((sample.published_ns - sample.anchor_ns) != (int64_t)(sample.epoch - BENCH_EPOCH_BASE))
+        reader->torn++;
+    }
+  }
+  reader->seconds = (DS1307_shm_monotonic_ns() - start_ns) / 1e9;
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  static struct bench_reader reader[BENCH_READERS_MAX];
+  pthread_t publisher;
+  uint32_t readers = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1;
+  uint32_t seconds = (argc > 2) ? (uint32_t)atoi(argv[2]) : 2;
+  uint64_t total_reads = 0, total_torn = 0, total_backward = 0, total_failed = 0;
+  double total_rate = 0;
+  if (argc > 3)
+    bench_publish_us = (uint32_t)atoi(argv[3]);
+  if ((readers < 1) || (readers > BENCH_READERS_MAX) || (seconds < 1) || (bench_publish_us < 1))
+  {
+    fprintf(stderr, "usage: %s [readers 1 to %u] [seconds] [publish us]\n", argv[0], BENCH_READERS_MAX);
+    return 2;
+  }
+  bench_page = DS1307_shm_create(BENCH_SHM_NAME);
+  if (bench_page == NULL)
+  {
+    perror(BENCH_SHM_NAME);
+    return 2;
+  }
+  /*a first publish, so no reader fails on an empty page*/
+  DS1307_shm_publish(bench_page, BENCH_EPOCH_BASE, DS1307_IS_RUNNING, DS1307_shm_monotonic_ns(), DS1307_shm_monotonic_ns());
+  pthread_create(&publisher, NULL, bench_publisher, NULL);
+  for (uint32_t index = 0; index < readers; index++)
+  {
+    reader[index].page = DS1307_shm_attach(BENCH_SHM_NAME);
+    if (reader[index].page == NULL)
+    {
+      perror(BENCH_SHM_NAME);
+      return 2;
+    }
+    pthread_create(&reader[index].thread, NULL, bench_read, &reader[index]);
+  }
+  sleep(seconds);
+  __atomic_store_n(&bench_stop, 1, __ATOMIC_RELAXED);
+  pthread_join(publisher, NULL);
+  printf("%u readers, %ld cpus online, a publish every %u us (%llu publishes)\n", readers, sysconf(_SC_NPROCESSORS_ONLN), bench_publish_us, (unsigned long long)bench_publishes);
+  for (uint32_t index = 0; index < readers; index++)
+  {
+    pthread_join(reader[index].thread, NULL);
+    printf("  reader %2u: %6.2f M reads/s, %llu torn, %llu backward, %llu failed\n", index, reader[index].reads / reader[index].seconds / 1e6,
+           (unsigned long long)reader[index].torn, (unsigned long long)reader[index].backward, (unsigned long long)reader[index].failed);
+    total_rate += reader[index].reads / reader[index].seconds;
+    total_reads += reader[index].reads;
+    total_torn += reader[index].torn;
+    total_backward += reader[index].backward;
+    total_failed += reader[index].failed;
+    DS1307_shm_detach(reader[index].page);
+  }
+  printf("  total:     %6.2f M reads/s (%llu reads), %llu torn, %llu backward, %llu failed\n", total_rate / 1e6, (unsigned long long)total_reads,
+         (unsigned long long)total_torn, (unsigned long long)total_backward, (unsigned long long)total_failed);
+  munmap(bench_page, sizeof(struct ds1307_shm_page));
+  shm_unlink(BENCH_SHM_NAME);
+  return (total_torn || total_backward) ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+/*ds1307 shared memory time daemon - Reza Ebrahimi v1.0*/
+/*owns the ds1307 bus and publishes its time into the DS1307_SHM_NAME page, see rtc_ds1307_shm.h.
+  build with rtc_ds1307.c, rtc_ds1307_low_level_linux.c and rtc_ds1307_shm.c, run as
+  rtc_ds1307_shm_daemon [/dev/i2c-N]. the clock is only read, never set or started*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+#include "rtc_ds1307.h"
+#include "rtc_ds1307_low_level_linux.h"
+#include "rtc_ds1307_shm.h"
+
+#define DAEMON_DEVICE_PATH              "/dev/i2c-1"
+#define DAEMON_PERIOD_MS                60000        /*time between two publishes, each one costs one edge lock on the bus*/
+#define DAEMON_EDGE_GUARD_MS            20        /*polling starts this long before the predicted second edge*/
+#define DAEMON_EDGE_TIMEOUT_MS          1500        /*longer than a second without an edge means a halted or missing clock*/
+#define DAEMON_POLL_US                  500        /*pause between two reads while waiting for the edge*/
+
+static void sleep_until(int64_t deadline_ns)
+{
+  struct timespec deadline;
+  deadline.tv_sec = deadline_ns / 1000000000LL;
+  deadline.tv_nsec = deadline_ns % 1000000000LL;
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+}
+
+/*reads the time until it steps to the next second. the step happened between the START of the last
+  read that saw the old second and the START of the first one that sees the new second (ds1307 latches
+  its time on START), anchor_ns is the middle of the two*/
+static uint8_t edge_lock(ds1307_t *rtc, uint32_t *epoch, int64_t *anchor_ns)
+{
+  uint32_t first_epoch, current_epoch;
+  int64_t start_ns, previous_ns, current_ns;
+  if (DS1307_run_state(rtc) != DS1307_IS_RUNNING)
+    return OPERATION_FAILED;
+  start_ns = DS1307_shm_monotonic_ns();
+  previous_ns = start_ns;
+  if (DS1307_read_epoch(rtc, &first_epoch) != OPERATION_DONE)
+    return OPERATION_FAILED;
+  for (;;)
+  {
+    sleep_until(DS1307_shm_monotonic_ns() + (DAEMON_POLL_US * 1000LL));
+    current_ns = DS1307_shm_monotonic_ns();
+    if (DS1307_read_epoch(rtc, &current_epoch) != OPERATION_DONE)
+      return OPERATION_FAILED;
+    if (current_epoch != first_epoch)
+      break;
+    if ((current_ns - start_ns) > (DAEMON_EDGE_TIMEOUT_MS * 1000000LL))
+      return OPERATION_FAILED;
+    previous_ns = current_ns;
+  }
+  *epoch = current_epoch;
+  *anchor_ns = previous_ns + ((current_ns - previous_ns) >> 1);
+  return OPERATION_DONE;
+}
+
+int main(int argc, char **argv)
+{
+  struct ds1307_linux_bus bus = DS1307_LINUX_BUS((argc > 1) ? argv[1] : DAEMON_DEVICE_PATH);
+  struct ds1307_shm_page *page;
+  ds1307_t rtc;
+  uint32_t epoch = 0;
+  int64_t anchor_ns, next_edge_ns;
+  DS1307_handle_init(&rtc, &bus, DS1307_I2C_ADDRESS);
+  DS1307_I2C_init(&bus);
+  if (bus.file < 0)
+  {
+    perror(bus.device_path);
+    return 1;
+  }
+  page = DS1307_shm_create(DS1307_SHM_NAME);
+  if (page == NULL)
+  {
+    perror(DS1307_SHM_NAME);
+    return 1;
+  }
+  for (;;)
+  {
+    if (edge_lock(&rtc, &epoch, &anchor_ns) == OPERATION_DONE)
+    {
+      DS1307_shm_publish(page, epoch, DS1307_IS_RUNNING, anchor_ns, DS1307_shm_monotonic_ns());
+      /*the next publish waits for an edge, DAEMON_PERIOD_MS is a whole number of seconds after this one*/
+      next_edge_ns = anchor_ns + (DAEMON_PERIOD_MS * 1000000LL);
+    }
+    else
+    {
+      /*halted clock or lost bus: readers fail until the clock is read again, the last epoch is left in the page*/
+      DS1307_shm_publish(page, epoch, DS1307_IS_STOPPED, 0, DS1307_shm_monotonic_ns());
+      next_edge_ns = DS1307_shm_monotonic_ns() + (DAEMON_PERIOD_MS * 1000000LL);
+    }
+    sleep_until(next_edge_ns - (DAEMON_EDGE_GUARD_MS * 1000000LL));
+  }
+}
@@ -0,0 +1,59 @@
+/*ds1307 simulator header file - Reza Ebrahimi v1.0*/
+/*controls for the software ds1307 in rtc_ds1307_low_level_sim.c*/
+#ifndef RTC_DS1307_SIM_H
+#define RTC_DS1307_SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DS1307_SIM_BUS_STANDARD               100000
+#define DS1307_SIM_BUS_FAST                   400000
+#define DS1307_SIM_BITS_PER_BYTE              9        /*8 data bits and ACK*/
+#define DS1307_SIM_REGISTER_FILE_SIZE         0X40
+
+struct ds1307_transaction;
+
+struct ds1307_sim_stats {
+  uint32_t transactions;        /*START to STOP, a repeated start does not count as a new one*/
+  uint32_t bytes_read;
+  uint32_t bytes_written;        /*register address bytes included, device address bytes not*/
+  uint64_t bus_time_ns;
+  uint32_t failed_transactions;        /*NACKed ones, counted in transactions as well*/
+  uint32_t recoveries;        /*time_i2c_recover calls*/
+};
+
+/*one simulated chip on its own bus, give a pointer to it to DS1307_handle_init as bus. a handle with
+  a NULL bus uses a default chip. all chips share one simulated time*/
+struct ds1307_sim {
+  uint8_t sim_register[DS1307_SIM_REGISTER_FILE_SIZE];        /*timekeeping registers, control and 56 bytes of RAM*/
+  uint8_t sim_register_pointer;        /*auto-incremented after every byte, wraps from 0X3F to 0X00*/
+  uint8_t sim_powered;
+  uint32_t sim_bus_speed;        /*0 is DS1307_SIM_BUS_STANDARD*/
+  uint64_t sim_countdown_ns;        /*sub-second part of the oscillator countdown chain*/
+  uint64_t sim_updated_ns;        /*simulated time the registers were last brought up to*/
+  struct ds1307_sim_stats sim_stats;
+  uint32_t sim_fail_count;        /*transactions still to be NACKed, set by DS1307_sim_fail*/
+  uint32_t sim_lose_count;        /*submitted transactions still to be left without a completion, set by DS1307_sim_lose*/
+  struct ds1307_transaction *sim_async_transaction;        /*submitted transaction on the bus, NULL when idle*/
+  uint64_t sim_async_done_ns;        /*simulated time its STOP is sent*/
+  uint8_t sim_async_status;        /*OPERATION_DONE, or OPERATION_FAILED for a NACKed one*/
+  struct ds1307_sim *sim_next;        /*list of powered chips, walked by DS1307_sim_advance_us*/
+};
+
+void DS1307_sim_power_on(struct ds1307_sim *sim);
+void DS1307_sim_bus_speed(struct ds1307_sim *sim, uint32_t bus_speed);
+void DS1307_sim_advance_us(uint32_t microseconds);
+void DS1307_sim_fail(struct ds1307_sim *sim, uint32_t fail_count);
+void DS1307_sim_lose(struct ds1307_sim *sim, uint32_t lose_count);
+void DS1307_sim_stats(struct ds1307_sim *sim, struct ds1307_sim_stats *stats);
+void DS1307_sim_stats_reset(struct ds1307_sim *sim);
+uint8_t *DS1307_sim_registers(struct ds1307_sim *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
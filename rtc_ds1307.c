@@ -4,11 +4,79 @@
 
 static void BCD_to_HEX(uint8_t *data_array, uint8_t array_length);        /*turns the bcd numbers from ds1307 into hex*/
 static void HEX_to_BCD(uint8_t *data_array, uint8_t array_length);        /*turns the hex numbers into bcd, to be written back into ds1307*/
+static uint8_t DS1307_burst_read(ds1307_t *rtc, uint8_t *data_array, uint8_t array_length);        /*reads timekeeping registers from SECONDS in one i2c transaction*/
+static uint8_t register_read(ds1307_t *rtc, uint8_t register_address, uint8_t *data_array, uint8_t array_length);        /*every bus read of the driver goes through here*/
+static uint8_t register_write(ds1307_t *rtc, uint8_t register_address, uint8_t *data_array, uint8_t array_length);        /*every bus write of the driver goes through here*/
+static uint8_t register_read_cached(ds1307_t *rtc, uint8_t register_address, uint8_t *data_byte);        /*served from the shadow cache when possible*/
+static void register_track(ds1307_t *rtc, uint8_t api, uint8_t direction, uint8_t register_address, uint8_t *data_array, uint8_t array_length, uint8_t status);        /*counters and shadow cache of a finished bus transfer*/
+static uint8_t run_update(ds1307_t *rtc, uint8_t run_state);        /*body of DS1307_run, for use inside other api calls*/
+static uint8_t now_resync(ds1307_t *rtc);        /*body of DS1307_now_resync, for use inside other api calls*/
+static uint32_t now_elapsed(ds1307_t *rtc, uint32_t tick, uint32_t tick_ms, uint32_t rounding_us);        /*whole seconds since the DS1307_now anchor*/
+#if DS1307_ROLLOVER_CHECK
+static uint8_t time_settled(const uint8_t *previous_array, const uint8_t *data_array);        /*two bcd time reads agree from MINUTES to YEAR*/
+#endif
+static void time_advance(uint8_t *data_array, uint32_t seconds);        /*adds seconds to a 7 byte time array, with calendar rollover*/
+static uint32_t time_to_seconds(const uint8_t *data_array);        /*seconds since 2000-01-01 00:00:00 of a 7 byte time array*/
+static void seconds_to_time(uint32_t seconds, uint8_t *data_array);        /*inverse of time_to_seconds, day of week 1 is sunday*/
+static uint16_t days_from_civil(uint8_t year, uint8_t month, uint8_t date);        /*days since 2000-01-01, closed form*/
+static void time_write(ds1307_t *rtc, uint8_t *data_array);        /*one burst of a bcd time into SECONDS to YEAR, CH kept*/
+static void stage_field(uint8_t *register_image, uint8_t option, uint8_t value);        /*register value of one decoded field, SECOND to CONTROL*/
+static void stage_write(ds1307_t *rtc, uint8_t *register_image, uint8_t dirty_mask);        /*writes the marked registers of an image in contiguous bursts*/
+static void snapshot_load(ds1307_t *rtc);        /*reads the snapshot ring into the handle when it is not there yet*/
+static void snapshot_check(ds1307_t *rtc);        /*empties a freshly read ring that fails its crc*/
+static uint8_t snapshot_append(ds1307_t *rtc, const uint8_t *data_array);        /*adds a time to the ring image, returns its slot*/
+static uint8_t snapshot_decode(ds1307_t *rtc, uint8_t index, uint8_t *data_array);        /*time of the index-th newest snapshot*/
+static uint8_t snapshot_crc(const uint8_t *snapshot_image);        /*crc-8 of the head and live slots of a ring image*/
+static uint32_t api_enter(ds1307_t *rtc, uint8_t api);        /*takes the handle lock and starts the counters of a public api call*/
+static uint8_t api_exit(ds1307_t *rtc, uint32_t start_tick);        /*records the latency of the call, releases the handle lock and returns its bus status*/
+#define DS1307_API_ENTER(rtc, api)      uint32_t api_start_tick = api_enter(rtc, api)
+#define DS1307_API_EXIT(rtc)            api_exit(rtc, api_start_tick)
+#define SNAPSHOT_SLOT_OFFSET(slot)      ((DS1307_SNAPSHOT_RING_START - DS1307_REGISTER_SNAPSHOT_HEAD) + ((slot) * DS1307_SNAPSHOT_SLOT_SIZE))        /*slot position inside snapshot_image*/
+#if DS1307_STATS
+#define DS1307_STATS_API(rtc)           ((rtc)->stats_api)
+#else
+#define DS1307_STATS_API(rtc)           STATS_API_COUNT
+#endif
+#if DS1307_ASYNC
+static uint8_t async_start(ds1307_t *rtc, uint8_t job, uint8_t option, uint8_t *data_array, ds1307_callback_t callback, void *callback_context);        /*starts the state machine of an async call*/
+static uint8_t async_advance(ds1307_t *rtc);        /*next step of the async call once its posted transactions are done*/
+static void async_post(ds1307_t *rtc, uint8_t direction, uint8_t register_address, uint8_t *data_array, uint8_t data_length);        /*queues one transaction of the async call*/
+static void async_submit(ds1307_t *rtc);        /*hands the head posted transaction to the bus and starts its deadline*/
+static void async_finish(ds1307_t *rtc, uint8_t status);        /*ends the async call and runs its callback*/
+static uint8_t async_span(uint8_t option, uint8_t *register_address, uint8_t *data_length);        /*registers that an option covers*/
+static const uint8_t async_job_api[] = {STATS_API_COUNT, STATS_READ, STATS_SET, STATS_SNAPSHOT};        /*counters each DS1307_ASYNC_JOB_* is charged to*/
+#endif
+#if DS1307_DRIFT_TRIM
+static void trim_load(ds1307_t *rtc);        /*reads the trim and its anchor into the handle when they are not there yet*/
+static void trim_unpack(ds1307_t *rtc, const uint8_t *trim_image);        /*loads the handle copy from the 5 bytes at DS1307_REGISTER_TRIM*/
+static void trim_time(ds1307_t *rtc, uint8_t *data_array);        /*removes the drift from a decoded time just read*/
+#if DS1307_ASYNC
+static void async_trim_post(ds1307_t *rtc);        /*fills async_trim_image for an async time read, from the handle or from ds1307*/
+#endif
+static void trim_rebase(ds1307_t *rtc, const uint8_t *data_array);        /*moves the trim anchor to a bcd time just written*/
+static uint32_t trim_anchor_of(const uint8_t *data_array);        /*unix time of a bcd SECONDS to YEAR image*/
+static uint32_t trim_correct(ds1307_t *rtc, uint32_t epoch);        /*removes the drift since the trim anchor from a unix time*/
+static int32_t trim_round(int32_t dividend, int32_t divisor);        /*division rounded to the nearest, halves away from zero*/
+#endif
 
-static uint8_t register_current_value;        /*used to read current values of ds1307 registers*/
-static uint8_t register_new_value;        /*used to write values to ds1307 registers*/
-static uint8_t snap0_vacancy;       /*if snap0_vacancy == OCCUPIED, then a snapshot has been saved on ds1307 RAM and is ready to be read*/
-static uint8_t register_default_value[] = {       /*used in reset function, contains default zero values*/
+static const uint8_t days_in_month[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+static const uint16_t days_before_month[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};        /*of a common year*/
+#if DS1307_BCD_CONVERSION == DS1307_BCD_TABLE
+static const uint8_t bcd_tens_table[] = {0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150};        /*high nibble of a bcd byte times ten*/
+static const uint8_t hex_to_bcd_table[] = {        /*bcd value of 0 to 99*/
+  0X00, 0X01, 0X02, 0X03, 0X04, 0X05, 0X06, 0X07, 0X08, 0X09,
+  0X10, 0X11, 0X12, 0X13, 0X14, 0X15, 0X16, 0X17, 0X18, 0X19,
+  0X20, 0X21, 0X22, 0X23, 0X24, 0X25, 0X26, 0X27, 0X28, 0X29,
+  0X30, 0X31, 0X32, 0X33, 0X34, 0X35, 0X36, 0X37, 0X38, 0X39,
+  0X40, 0X41, 0X42, 0X43, 0X44, 0X45, 0X46, 0X47, 0X48, 0X49,
+  0X50, 0X51, 0X52, 0X53, 0X54, 0X55, 0X56, 0X57, 0X58, 0X59,
+  0X60, 0X61, 0X62, 0X63, 0X64, 0X65, 0X66, 0X67, 0X68, 0X69,
+  0X70, 0X71, 0X72, 0X73, 0X74, 0X75, 0X76, 0X77, 0X78, 0X79,
+  0X80, 0X81, 0X82, 0X83, 0X84, 0X85, 0X86, 0X87, 0X88, 0X89,
+  0X90, 0X91, 0X92, 0X93, 0X94, 0X95, 0X96, 0X97, 0X98, 0X99
+};
+#endif
+static const uint8_t register_default_value[] = {       /*used in reset function, contains default zero values*/
   DS1307_REGISTER_SECONDS_DEFAULT,
   DS1307_REGISTER_MINUTES_DEFAULT,
   DS1307_REGISTER_HOURS_DEFAULT,
@@ -19,358 +87,1795 @@ static uint8_t register_default_value[] = {       /*used in reset function, cont
   DS1307_REGISTER_CONTROL_DEFAULT
 };
 
+/*prepares a driver handle for the ds1307 at address on bus. bus is handed untouched to every
+  time_i2c_* call of this handle, its meaning is up to the low level api (NULL for single bus ports)*/
+void DS1307_handle_init(ds1307_t *rtc, void *bus, uint8_t address)
+{
+  uint8_t *handle_byte = (uint8_t *)rtc;
+  for (uint16_t index = 0; index < sizeof(ds1307_t); index++)
+    handle_byte[index] = 0X00;
+  rtc->bus = bus;
+  rtc->address = address;
+  rtc->now_anchor_state = DS1307_NOW_UNANCHORED;
+  rtc->bus_status = OPERATION_DONE;
+#if DS1307_ASYNC
+  rtc->async_status = OPERATION_DONE;
+#endif
+}
+
+/*optional, lock and unlock are called around every api call on this handle with lock_context, so
+  several threads can share one handle. handles on different buses need no lock between them*/
+void DS1307_lock_hook(ds1307_t *rtc, void (*lock)(void *lock_context), void (*unlock)(void *lock_context), void *lock_context)
+{
+  rtc->lock = lock;
+  rtc->unlock = unlock;
+  rtc->lock_context = lock_context;
+}
+
 /*ds1307_init function accepts 3 inputs, data_array[7] is the new time settings,
   run_state commands ds1307 to run or halt (CLOCK_RUN and CLOCK_HALT), and reset_state
   could force reset ds1307 (FORCE_RESET) or checks if ds1307 is reset beforehand
   (NO_FORCE_RESET)*/
-uint8_t DS1307_init(uint8_t *data_array, uint8_t run_state, uint8_t reset_state)
+uint8_t DS1307_init(ds1307_t *rtc, uint8_t *data_array, uint8_t run_state, uint8_t reset_state)
 {
-  DS1307_I2C_init();
-  if ((DS1307_init_status_report() == DS1307_NOT_INITIALIZED) || (reset_state == FORCE_RESET))
+  uint8_t status;
+  uint8_t register_image[DS1307_REGISTER_FILE_SIZE];
+  DS1307_API_ENTER(rtc, STATS_INIT);
+  DS1307_I2C_init(rtc->bus);
+  register_read_cached(rtc, DS1307_REGISTER_INIT_STATUS, &register_image[DS1307_REGISTER_INIT_STATUS]);
+  /*an unreadable status byte is not taken as a fresh chip, the clock is left alone*/
+  if (rtc->bus_status != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  else if ((register_image[DS1307_REGISTER_INIT_STATUS] != DS1307_INITIALIZED) || (reset_state == FORCE_RESET))
   {
-    DS1307_run(CLOCK_HALT);
-    DS1307_reset(ALL);       /*everything but the 56 bytes general purpose ram inside ds1307*/
-    DS1307_reset(RAM);        /*fills ds1307 general purpose ram wiith default value*/
-    DS1307_set(TIME, data_array);
-    DS1307_run(run_state);
-    DS1307_init_status_update();        /*now the device is initialized (DS1307_INITIALIZED)*/
-    return OPERATION_DONE;
+    /*the whole register file is built in memory: new time with CH already in place, default control,
+      cleared general purpose ram and the init status byte*/
+    for (uint8_t index = 0; index < 7; index++)
+      register_image[index] = data_array[index];
+    HEX_to_BCD(register_image, 7);
+    if (run_state != CLOCK_RUN)
+      register_image[DS1307_REGISTER_SECONDS] |= (1 << DS1307_BIT_SETTING_CH);
+    register_image[DS1307_REGISTER_HOURS] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+    register_image[DS1307_REGISTER_CONTROL] = DS1307_REGISTER_CONTROL_DEFAULT;
+    for (uint8_t index = DS1307_RAM_START; index < DS1307_REGISTER_FILE_SIZE; index++)
+      register_image[index] = DS1307_RAM_BLOCK_DEFAULT;
+    register_image[DS1307_REGISTER_INIT_STATUS] = DS1307_INITIALIZED;
+    register_image[DS1307_REGISTER_SNAPSHOT_CRC] = snapshot_crc(&register_image[DS1307_REGISTER_SNAPSHOT_HEAD]);
+    /*two bursts, ram first and then 0X00 to 0X08, so the init status only lands once everything else has*/
+    register_write(rtc, DS1307_REGISTER_INIT_STATUS + 1, &register_image[DS1307_REGISTER_INIT_STATUS + 1], DS1307_REGISTER_FILE_SIZE - DS1307_REGISTER_INIT_STATUS - 1);
+    register_write(rtc, DS1307_TIMEKEEPER_REGISTERS_START, register_image, DS1307_REGISTER_INIT_STATUS + 1);
+    status = OPERATION_DONE;
   }
   else
   {
-    DS1307_run(run_state);
-    return OPERATION_FAILED;
+    run_update(rtc, run_state);
+    status = OPERATION_FAILED;
   }
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
 }
 
 /*we use 1 byte of ds1307 ram to preserve the initialization status. this function reads that 1 byte*/
-uint8_t DS1307_init_status_report()
+uint8_t DS1307_init_status_report(ds1307_t *rtc)
 {
-  time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_INIT_STATUS, &register_current_value);
-  if (register_current_value == DS1307_INITIALIZED)
+  uint8_t register_current_value;
+  DS1307_API_ENTER(rtc, STATS_INIT_STATUS);
+  register_read_cached(rtc, DS1307_REGISTER_INIT_STATUS, &register_current_value);
+  if ((DS1307_API_EXIT(rtc) == OPERATION_DONE) && (register_current_value == DS1307_INITIALIZED))
     return DS1307_INITIALIZED;
   else
     return DS1307_NOT_INITIALIZED;
 }
 
 /*this function writes DS1307_INITIALIZED inside DS1307_REGISTER_INIT_STATUS*/
-void DS1307_init_status_update()
+uint8_t DS1307_init_status_update(ds1307_t *rtc)
 {
-  register_new_value = DS1307_INITIALIZED;
-  time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_INIT_STATUS, &register_new_value);
+  uint8_t register_new_value = DS1307_INITIALIZED;
+  DS1307_API_ENTER(rtc, STATS_INIT_STATUS);
+  register_write(rtc, DS1307_REGISTER_INIT_STATUS, &register_new_value, 1);
+  return DS1307_API_EXIT(rtc);
 }
 
 /*function to start or halt the operation of DS1307, using CH control bit in SECONDS register
   also preserves the contents of SECONDS register*/
-uint8_t DS1307_run(uint8_t run_state)
+uint8_t DS1307_run(ds1307_t *rtc, uint8_t run_state)
 {
-  /*preserving the contents of SECONDS register and changing CH bit*/
-  time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-  if (run_state == CLOCK_RUN)
-  {
-    /*CH=0 runs the clock*/
-    register_new_value = register_current_value & (~(1 << DS1307_BIT_SETTING_CH));
-  }
-  else if (run_state == CLOCK_HALT)
-  {
-    /*CH=1 halts the clock*/
-    register_new_value = register_current_value | (1 << DS1307_BIT_SETTING_CH);
-  }
-  else
-    return OPERATION_FAILED;
-  /*write the new value back to SECONDS register*/
-  time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
-  return OPERATION_DONE;
+  uint8_t status;
+  DS1307_API_ENTER(rtc, STATS_RUN);
+  status = run_update(rtc, run_state);
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
 }
 
-/*polls the ds1307 to see if its running*/
-uint8_t DS1307_run_state(void)
+/*polls the ds1307 to see if its running. a failed read reports DS1307_IS_STOPPED, see DS1307_last_status*/
+uint8_t DS1307_run_state(ds1307_t *rtc)
 {
-  time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-  if (register_current_value & (1 << DS1307_BIT_SETTING_CH))
-    return DS1307_IS_RUNNING;
-  else
+  uint8_t register_current_value;
+  DS1307_API_ENTER(rtc, STATS_RUN);
+  register_read(rtc, DS1307_REGISTER_SECONDS, &register_current_value, 1);
+  if ((DS1307_API_EXIT(rtc) != OPERATION_DONE) || (register_current_value & (1 << DS1307_BIT_SETTING_CH)))
     return DS1307_IS_STOPPED;
+  else
+    return DS1307_IS_RUNNING;
 }
 
 /*resets the desired register(s), without affecting run_state*/
-void DS1307_reset(uint8_t option)
+uint8_t DS1307_reset(ds1307_t *rtc, uint8_t option)
 {
+  uint8_t register_current_value, register_new_value;
+  uint8_t status = OPERATION_DONE;
+  uint8_t default_value[DS1307_RAM_SIZE];
+  DS1307_API_ENTER(rtc, STATS_RESET);
+  /*bcd copy of the defaults, with 24 hours mode*/
+  for (uint8_t index = 0; index < sizeof(register_default_value); index++)
+    default_value[index] = register_default_value[index];
+  HEX_to_BCD(default_value, 7);
+  default_value[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
   switch (option)
   {
     case SECOND:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      HEX_to_BCD(&register_default_value[0], 1);
-      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | register_default_value[0];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
+      register_read_cached(rtc, DS1307_REGISTER_SECONDS, &register_current_value);
+      if (rtc->bus_status != OPERATION_DONE)
+        break;
+      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | default_value[0];
+      register_write(rtc, DS1307_REGISTER_SECONDS, &register_new_value, 1);
       break;
     case MINUTE:
-      HEX_to_BCD(&register_default_value[1], 1);
-      register_new_value = register_default_value[1];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_MINUTES, &default_value[1], 1);
       break;
     case HOUR:
-      HEX_to_BCD(&register_default_value[2], 1);
-      register_new_value = register_default_value[2] & (~(1 << DS1307_BIT_SETTING_AMPM));
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_HOURS, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_HOURS, &default_value[2], 1);
       break;
     case DAY_OF_WEEK:
-      HEX_to_BCD(&register_default_value[3], 1);
-      register_new_value = register_default_value[3];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_DAY_OF_WEEK, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_DAY_OF_WEEK, &default_value[3], 1);
       break;
     case DATE:
-      HEX_to_BCD(&register_default_value[4], 1);
-      register_new_value = register_default_value[4];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_DATE, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_DATE, &default_value[4], 1);
       break;
     case MONTH:
-      HEX_to_BCD(&register_default_value[5], 1);
-      register_new_value = register_default_value[5];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_MONTH, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_MONTH, &default_value[5], 1);
       break;
     case YEAR:
-      HEX_to_BCD(&register_default_value[6], 1);
-      register_new_value = register_default_value[6];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_YEAR, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_YEAR, &default_value[6], 1);
       break;
     case CONTROL:
-      register_new_value = DS1307_REGISTER_CONTROL_DEFAULT;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
+      register_write(rtc, DS1307_REGISTER_CONTROL, &default_value[7], 1);
       break;
     case TIME:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      HEX_to_BCD(&register_default_value[0], 1);
-      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | register_default_value[0];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
-      HEX_to_BCD(&register_default_value[2], 1);
-      register_default_value[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
-      time_i2c_write_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &register_default_value[1], 6);
+      register_read_cached(rtc, DS1307_REGISTER_SECONDS, &register_current_value);
+      if (rtc->bus_status != OPERATION_DONE)
+        break;
+      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | default_value[0];
+      register_write(rtc, DS1307_REGISTER_SECONDS, &register_new_value, 1);
+      register_write(rtc, DS1307_REGISTER_MINUTES, &default_value[1], 6);
+#if DS1307_DRIFT_TRIM
+      trim_rebase(rtc, default_value);
+#endif
       break;
     case ALL:        /*everything is reset but the general purpose ram*/
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      HEX_to_BCD(&register_default_value[0], 1);
-      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | register_default_value[0];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
-      HEX_to_BCD(&register_default_value[2], 1);
-      register_default_value[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
-      time_i2c_write_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &register_default_value[1], 7);
+      register_read_cached(rtc, DS1307_REGISTER_SECONDS, &register_current_value);
+      if (rtc->bus_status != OPERATION_DONE)
+        break;
+      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | default_value[0];
+      register_write(rtc, DS1307_REGISTER_SECONDS, &register_new_value, 1);
+      register_write(rtc, DS1307_REGISTER_MINUTES, &default_value[1], 7);
+#if DS1307_DRIFT_TRIM
+      trim_rebase(rtc, default_value);
+#endif
       break;
     case RAM:
-      for (uint8_t register_address = DS1307_RAM_START; register_address <= DS1307_RAM_END; register_address++)
-      {
-        register_new_value = DS1307_RAM_BLOCK_DEFAULT;
-        time_i2c_write_single(DS1307_I2C_ADDRESS, register_address, &register_new_value);
-      }
+      /*the whole ram in a single burst, with an empty snapshot ring*/
+      for (uint8_t index = 0; index < DS1307_RAM_SIZE; index++)
+        default_value[index] = DS1307_RAM_BLOCK_DEFAULT;
+      default_value[DS1307_REGISTER_SNAPSHOT_CRC - DS1307_RAM_START] = snapshot_crc(&default_value[DS1307_REGISTER_SNAPSHOT_HEAD - DS1307_RAM_START]);
+      register_write(rtc, DS1307_RAM_START, default_value, DS1307_RAM_SIZE);
       break;
     default:
+      status = OPERATION_FAILED;
       break;
   }
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
 }
 
-/*function to read internal registers of ds1307, one register at a time or all registers*/
-uint8_t DS1307_read(uint8_t option, uint8_t *data_array)
+/*function to read internal registers of ds1307, one register at a time or all registers. data_array
+  is not to be used when the call fails*/
+uint8_t DS1307_read(ds1307_t *rtc, uint8_t option, uint8_t *data_array)
 {
+  uint8_t register_current_value;
+  uint8_t status = OPERATION_DONE;
+  DS1307_API_ENTER(rtc, STATS_READ);
   switch (option)
   {
     case SECOND:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_SECONDS, &register_current_value, 1);
       *data_array = register_current_value & (~(1 << DS1307_BIT_SETTING_CH));
       BCD_to_HEX(data_array, 1);
       break;
     case MINUTE:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_MINUTES, &register_current_value, 1);
       *data_array = register_current_value;
       BCD_to_HEX(data_array, 1);
       break;
     case HOUR:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_HOURS, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_HOURS, &register_current_value, 1);
       *data_array = register_current_value & (~(1 << DS1307_BIT_SETTING_AMPM));
       BCD_to_HEX(data_array, 1);
       break;
     case DAY_OF_WEEK:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_DAY_OF_WEEK, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_DAY_OF_WEEK, &register_current_value, 1);
       *data_array = register_current_value;
       BCD_to_HEX(data_array, 1);
       break;
     case DATE:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_DATE, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_DATE, &register_current_value, 1);
       *data_array = register_current_value;
       BCD_to_HEX(data_array, 1);
       break;
     case MONTH:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_MONTH, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_MONTH, &register_current_value, 1);
       *data_array = register_current_value;
       BCD_to_HEX(data_array, 1);
       break;
     case YEAR:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_YEAR, &register_current_value);
+      register_read(rtc, DS1307_REGISTER_YEAR, &register_current_value, 1);
       *data_array = register_current_value;
       BCD_to_HEX(data_array, 1);
       break;
     case CONTROL:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_current_value);
+      register_read_cached(rtc, DS1307_REGISTER_CONTROL, &register_current_value);
       *data_array = register_current_value;
       break;
     case TIME:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      data_array[0] = register_current_value & (~(1 << DS1307_BIT_SETTING_CH));
-      time_i2c_read_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &data_array[1], 6);
+      DS1307_burst_read(rtc, data_array, 7);
       BCD_to_HEX(data_array, 7);
+#if DS1307_DRIFT_TRIM
+      trim_time(rtc, data_array);
+#endif
       break;
     case SNAPSHOT:
-      /*high level function to load a previously saved snapshot from ds1307 RAM. If there is
-         no saved snapshots, returns nothing. needs an array of 7 bytes as input to function*/
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SNAP0_VACANCY, &snap0_vacancy);
-      if (snap0_vacancy == OCCUPIED)
-      {
-        time_i2c_read_multi(DS1307_I2C_ADDRESS, DS1307_SNAP0_ADDRESS, data_array, 7);
-        BCD_to_HEX(data_array, 7);
-        break;
-      }
-      else
-        return OPERATION_FAILED;
+      /*newest snapshot of the ring, same as DS1307_snapshot_read(rtc, 0, data_array). fails and
+        leaves data_array alone if there is none*/
+      snapshot_load(rtc);
+      status = snapshot_decode(rtc, 0, data_array);
+      break;
     case ALL:
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      data_array[0] = register_current_value & (~(1 << DS1307_BIT_SETTING_CH));
-      time_i2c_read_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &data_array[1], 7);
+      DS1307_burst_read(rtc, data_array, 8);
       BCD_to_HEX(data_array, 7);
+#if DS1307_DRIFT_TRIM
+      trim_time(rtc, data_array);
+#endif
       break;
     default:
-      return OPERATION_FAILED;
+      status = OPERATION_FAILED;
+      break;
   }
-  return OPERATION_DONE;
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
 }
 
-/*function to set internal registers of ds1307, one register at a time or all registers*/
-uint8_t DS1307_set(uint8_t option, uint8_t *data_array)
+/*function to set internal registers of ds1307, one register at a time or all registers. the values
+  are converted in a copy, data_array is left as it was given*/
+uint8_t DS1307_set(ds1307_t *rtc, uint8_t option, uint8_t *data_array)
 {
+  uint8_t register_new_value[8];
+  uint8_t dirty_mask = 0X00;
   switch (option)
   {
     case SECOND:
-      HEX_to_BCD(data_array, 1);
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
-      break;
     case MINUTE:
-      HEX_to_BCD(data_array, 1);
-      register_new_value = *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &register_new_value);
-      break;
     case HOUR:
-      HEX_to_BCD(data_array, 1);
-      register_new_value = (~(1 << DS1307_BIT_SETTING_AMPM)) & *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_HOURS, &register_new_value);
-      break;
     case DAY_OF_WEEK:
-      HEX_to_BCD(data_array, 1);
-      register_new_value = *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_DAY_OF_WEEK, &register_new_value);
-      break;
     case DATE:
-      HEX_to_BCD(data_array, 1);
-      register_new_value = *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_DATE, &register_new_value);
-      break;
     case MONTH:
-      HEX_to_BCD(data_array, 1);
-      register_new_value = *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_MONTH, &register_new_value);
-      break;
     case YEAR:
-      HEX_to_BCD(data_array, 1);
-      register_new_value = *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_YEAR, &register_new_value);
-      break;
     case CONTROL:
-      register_new_value = *data_array;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
+      stage_field(register_new_value, option, *data_array);
+      dirty_mask = 1 << option;
       break;
-    case TIME:
-      HEX_to_BCD(data_array, 7);
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | data_array[0];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
-      data_array[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
-      time_i2c_write_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &data_array[1], 6);
+    case TIME:        /*SECONDS to YEAR in one burst*/
+      for (uint8_t index = SECOND; index <= YEAR; index++)
+        stage_field(register_new_value, index, data_array[index]);
+      dirty_mask = 0X7F;
       break;
-    case ALL:
-      HEX_to_BCD(data_array, 7);
-      time_i2c_read_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_current_value);
-      register_new_value = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | data_array[0];
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, &register_new_value);
-      data_array[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
-      time_i2c_write_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_MINUTES, &data_array[1], 7);
+    case ALL:        /*SECONDS to CONTROL in one burst*/
+      for (uint8_t index = SECOND; index <= CONTROL; index++)
+        stage_field(register_new_value, index, data_array[index]);
+      dirty_mask = 0XFF;
       break;
     default:
       return OPERATION_FAILED;
   }
+  DS1307_API_ENTER(rtc, STATS_SET);
+  stage_write(rtc, register_new_value, dirty_mask);
+  return DS1307_API_EXIT(rtc);
+}
+
+/*starts a new batch of field updates on the handle, anything staged and not committed is dropped.
+  the batch lives in the handle, threads sharing one handle have to keep begin to commit to themselves*/
+void DS1307_begin(ds1307_t *rtc)
+{
+  rtc->stage_dirty = 0X00;
+}
+
+/*stages value for one of SECOND to CONTROL (decoded, as DS1307_set takes it) without bus traffic.
+  staging a field again replaces its value. fails for any other option*/
+uint8_t DS1307_stage(ds1307_t *rtc, uint8_t option, uint8_t value)
+{
+  if (option > CONTROL)
+    return OPERATION_FAILED;
+  stage_field(rtc->stage_register, option, value);
+  rtc->stage_dirty |= (1 << option);
   return OPERATION_DONE;
 }
 
+/*writes the staged fields with one burst per run of neighbouring registers (MINUTE, HOUR and
+  CONTROL is two bursts, MINUTE to YEAR is one), CH is merged into SECONDS once. the batch is empty
+  afterwards, committing an empty batch makes no bus traffic. a failed commit keeps the batch, so it
+  can be committed again*/
+uint8_t DS1307_commit(ds1307_t *rtc)
+{
+  uint8_t status;
+  DS1307_API_ENTER(rtc, STATS_SET);
+  if (rtc->stage_dirty)
+    stage_write(rtc, rtc->stage_register, rtc->stage_dirty);
+  status = DS1307_API_EXIT(rtc);
+  if (status == OPERATION_DONE)
+    rtc->stage_dirty = 0X00;
+  return status;
+}
+
 /*function to utilize the square wave capability of ds1307 i 5 different modes:
    WAVE_OFF, WAVE_1 for 1Hz, WAVE_2 for 4.096KHz, WAVE_3 for 8.192KHz, WAVE_4
    for 32.768 KHz*/
-uint8_t DS1307_square_wave(uint8_t input)
+uint8_t DS1307_square_wave(ds1307_t *rtc, uint8_t input)
 {
+  uint8_t register_new_value;
   switch (input)
   {
     case WAVE_OFF:
       register_new_value = 0X00;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
-      return OPERATION_DONE;
+      break;
     case WAVE_1:
       register_new_value = 0X10;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
-      return OPERATION_DONE;
+      break;
     case WAVE_2:
       register_new_value = 0X11;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
-      return OPERATION_DONE;
+      break;
     case WAVE_3:
       register_new_value = 0X12;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
-      return OPERATION_DONE;
+      break;
     case WAVE_4:
       register_new_value = 0X13;
-      time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_CONTROL, &register_new_value);
-      return OPERATION_DONE;
+      break;
+    default:
+      return OPERATION_FAILED;
+  }
+  DS1307_API_ENTER(rtc, STATS_SQUARE_WAVE);
+  register_write(rtc, DS1307_REGISTER_CONTROL, &register_new_value, 1);
+  return DS1307_API_EXIT(rtc);
+}
+
+
+/*reads length bytes of ds1307 general purpose ram, starting offset bytes after DS1307_RAM_START,
+  in one burst. fails without bus traffic if the range leaves the 56 bytes of ram*/
+uint8_t DS1307_ram_read(ds1307_t *rtc, uint8_t offset, uint8_t *data_array, uint8_t length)
+{
+  if ((length == 0) || (offset >= DS1307_RAM_SIZE) || (length > (DS1307_RAM_SIZE - offset)))
+    return OPERATION_FAILED;
+  DS1307_API_ENTER(rtc, STATS_RAM);
+  register_read(rtc, DS1307_RAM_START + offset, data_array, length);
+  return DS1307_API_EXIT(rtc);
+}
+
+/*writes length bytes into ds1307 general purpose ram, starting offset bytes after DS1307_RAM_START,
+  in one burst. the ram up to DS1307_SNAPSHOT_RING_END is used by the driver itself (init status,
+  snapshot ring), and so are 0X3B to 0X3F (the drift trim and its anchor) with DS1307_DRIFT_TRIM. the
+  rest is free. a write over the driver bytes is not refused, the handle drops its copy of them*/
+uint8_t DS1307_ram_write(ds1307_t *rtc, uint8_t offset, uint8_t *data_array, uint8_t length)
+{
+  if ((length == 0) || (offset >= DS1307_RAM_SIZE) || (length > (DS1307_RAM_SIZE - offset)))
+    return OPERATION_FAILED;
+  DS1307_API_ENTER(rtc, STATS_RAM);
+  register_write(rtc, DS1307_RAM_START + offset, data_array, length);
+  return DS1307_API_EXIT(rtc);
+}
+
+/*high level function to save a snapshot of the current time to the ring in ds1307 RAM. the ring
+  keeps the last DS1307_SNAPSHOT_SLOTS snapshots, 4 bytes each, a save on a full ring overwrites the
+  oldest one. the ring is kept in the handle, so a save is a time read and two short writes*/
+uint8_t DS1307_snapshot_save(ds1307_t *rtc)
+{
+  uint8_t data_array_temporary[7];
+  uint8_t slot;
+  DS1307_API_ENTER(rtc, STATS_SNAPSHOT);
+  snapshot_load(rtc);
+  DS1307_burst_read(rtc, data_array_temporary, 7);
+  BCD_to_HEX(data_array_temporary, 7);
+#if DS1307_DRIFT_TRIM
+  trim_time(rtc, data_array_temporary);
+#endif
+  slot = snapshot_append(rtc, data_array_temporary);
+  /*the slot first, then head and crc: a save cut in between leaves the old ring valid unless the
+    slot was the oldest snapshot of a full ring*/
+  register_write(rtc, DS1307_SNAPSHOT_RING_START + (slot * DS1307_SNAPSHOT_SLOT_SIZE), &rtc->snapshot_image[SNAPSHOT_SLOT_OFFSET(slot)], DS1307_SNAPSHOT_SLOT_SIZE);
+  register_write(rtc, DS1307_REGISTER_SNAPSHOT_HEAD, rtc->snapshot_image, 2);
+  rtc->snapshot_state = DS1307_SNAPSHOT_LOADED;
+  return DS1307_API_EXIT(rtc);
+}
+
+/*reads the index-th newest snapshot into data_array[7] (0 is the last save), in the format of
+  DS1307_read(TIME) with 24 hours and day of week 1 for sunday. fails if there are not that many*/
+uint8_t DS1307_snapshot_read(ds1307_t *rtc, uint8_t index, uint8_t *data_array)
+{
+  uint8_t status;
+  DS1307_API_ENTER(rtc, STATS_SNAPSHOT);
+  snapshot_load(rtc);
+  status = snapshot_decode(rtc, index, data_array);
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
+}
+
+/*number of snapshots in the ring, up to DS1307_SNAPSHOT_SLOTS. 0 when the ring cannot be read*/
+uint8_t DS1307_snapshot_count(ds1307_t *rtc)
+{
+  uint8_t count;
+  DS1307_API_ENTER(rtc, STATS_SNAPSHOT);
+  snapshot_load(rtc);
+  count = rtc->snapshot_image[0] >> 4;
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    count = 0;
+  return count;
+}
+
+/*high level function to empty the snapshot ring on ds1307 RAM, one write of head and crc*/
+uint8_t DS1307_snapshot_clear(ds1307_t *rtc)
+{
+  DS1307_API_ENTER(rtc, STATS_SNAPSHOT);
+  rtc->snapshot_image[0] = 0X00;
+  rtc->snapshot_image[1] = snapshot_crc(rtc->snapshot_image);
+  register_write(rtc, DS1307_REGISTER_SNAPSHOT_HEAD, rtc->snapshot_image, 2);
+  rtc->snapshot_state = DS1307_SNAPSHOT_LOADED;
+  return DS1307_API_EXIT(rtc);
+}
+
+/*reads the time as seconds since 1970-01-01 00:00:00 (unix time, the ds1307 time taken as utc) in one
+  burst. the days up to the current date are kept in the handle, so only the time of day is worked
+  out again until the date changes*/
+uint8_t DS1307_read_epoch(ds1307_t *rtc, uint32_t *epoch)
+{
+  uint8_t data_array_temporary[7];
+  DS1307_API_ENTER(rtc, STATS_READ);
+  DS1307_burst_read(rtc, data_array_temporary, 7);
+  if (rtc->bus_status != OPERATION_DONE)
+    return DS1307_API_EXIT(rtc);
+  if ((data_array_temporary[4] != rtc->epoch_date[0]) || (data_array_temporary[5] != rtc->epoch_date[1]) || (data_array_temporary[6] != rtc->epoch_date[2]))
+  {
+    for (uint8_t index = 0; index < 3; index++)
+      rtc->epoch_date[index] = data_array_temporary[index + 4];
+    BCD_to_HEX(&data_array_temporary[4], 3);
+    rtc->epoch_days = days_from_civil(data_array_temporary[6], data_array_temporary[5], data_array_temporary[4]);
+  }
+  data_array_temporary[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+  BCD_to_HEX(data_array_temporary, 3);
+  *epoch = DS1307_EPOCH_2000 + ((uint32_t)rtc->epoch_days * 86400UL) + (data_array_temporary[2] * 3600UL) + (data_array_temporary[1] * 60) + data_array_temporary[0];
+#if DS1307_DRIFT_TRIM
+  trim_load(rtc);
+  *epoch = trim_correct(rtc, *epoch);
+#endif
+  return DS1307_API_EXIT(rtc);
+}
+
+/*sets the time from seconds since 1970-01-01 00:00:00, in one burst and without changing the run
+  state. day of week is set with 1 for sunday. fails outside 2000 to 2099, the range of YEAR*/
+uint8_t DS1307_set_epoch(ds1307_t *rtc, uint32_t epoch)
+{
+  uint8_t data_array_temporary[7];
+  if ((epoch < DS1307_EPOCH_2000) || (epoch >= DS1307_EPOCH_2100))
+    return OPERATION_FAILED;
+  DS1307_API_ENTER(rtc, STATS_SET);
+  seconds_to_time(epoch - DS1307_EPOCH_2000, data_array_temporary);
+  HEX_to_BCD(data_array_temporary, 7);
+  time_write(rtc, data_array_temporary);
+  return DS1307_API_EXIT(rtc);
+}
+
+/*sets the time so that SECONDS lands on a whole second of a host reference: the host time was epoch
+  and microseconds at time_tick_us() == reference_tick (taken within the last hour, time_tick_us wraps
+  after 71 minutes). the latency from the call to the ACK of SECONDS is measured with two reads through
+  the low level (one byte, then seven, so the per call overhead and the byte time come apart), then
+  the driver spins until the next whole second minus that latency and writes SECONDS to YEAR in one
+  burst. the countdown chain of ds1307 restarts on that ACK, so its second edges line up with the
+  host. the run state is kept. blocks for up to a second, fails outside 2000 to 2099, if the latency
+  is over DS1307_SYNC_LATENCY_MAX_US, if the next second is missed DS1307_SYNC_PASSES times in a row
+  or if the read back does not match. a running clock leaves DS1307_now anchored on the new edge*/
+uint8_t DS1307_set_sync(ds1307_t *rtc, uint32_t epoch, uint32_t microseconds, uint32_t reference_tick)
+{
+  uint8_t register_new_value[7], register_current_value[7];
+  uint8_t status = OPERATION_DONE;
+  uint8_t pass = 0;
+  uint32_t probe_tick[3];
+  uint32_t byte_time, call_overhead, write_latency;
+  uint32_t now_tick, write_tick, phase, seconds;
+  DS1307_API_ENTER(rtc, STATS_SET);
+  probe_tick[0] = time_tick_us();
+  register_read(rtc, DS1307_REGISTER_SECONDS, register_current_value, 1);
+  probe_tick[1] = time_tick_us();
+  register_read(rtc, DS1307_REGISTER_SECONDS, register_current_value, 7);
+  probe_tick[2] = time_tick_us();
+  /*a one byte read is START, address, register pointer, repeated START, address and one byte on the
+    bus (4 bytes), a seven byte read is 6 bytes longer. the write below is acknowledged for SECONDS
+    after its address, register pointer and first data byte (3 bytes)*/
+  byte_time = 0;
+  if ((probe_tick[2] - probe_tick[1]) > (probe_tick[1] - probe_tick[0]))
+    byte_time = ((probe_tick[2] - probe_tick[1]) - (probe_tick[1] - probe_tick[0])) / 6;
+  call_overhead = probe_tick[1] - probe_tick[0];
+  call_overhead = (call_overhead > (4 * byte_time)) ? (call_overhead - (4 * byte_time)) : 0;
+  write_latency = call_overhead + (3 * byte_time);
+  /*a latency near a second would put every write tick in the past, so it would never be reached*/
+  if ((rtc->bus_status != OPERATION_DONE) || (write_latency > DS1307_SYNC_LATENCY_MAX_US))
+    status = OPERATION_FAILED;
+  /*the time is worked out again if the next whole second came too close while it was encoded*/
+  while (status == OPERATION_DONE)
+  {
+    if (pass++ == DS1307_SYNC_PASSES)
+    {
+      status = OPERATION_FAILED;
+      break;
+    }
+    now_tick = time_tick_us();
+    phase = microseconds + (now_tick - reference_tick);
+    seconds = epoch + (phase / 1000000) + 1;
+    write_tick = now_tick + (1000000 - (phase % 1000000)) - write_latency;
+    if ((seconds < DS1307_EPOCH_2000) || (seconds >= DS1307_EPOCH_2100))
+    {
+      status = OPERATION_FAILED;
+      break;
+    }
+    seconds_to_time(seconds - DS1307_EPOCH_2000, register_new_value);
+    HEX_to_BCD(register_new_value, 7);
+    register_new_value[DS1307_REGISTER_SECONDS] |= register_current_value[DS1307_REGISTER_SECONDS] & (1 << DS1307_BIT_SETTING_CH);
+    if ((int32_t)(time_tick_us() - write_tick) < 0)
+      break;
+  }
+  if (status == OPERATION_DONE)
+  {
+    while ((int32_t)(time_tick_us() - write_tick) < 0)
+      ;
+    register_write(rtc, DS1307_REGISTER_SECONDS, register_new_value, 7);
+    register_read(rtc, DS1307_REGISTER_SECONDS, register_current_value, 7);
+    for (uint8_t index = 0; index < 7; index++)
+      if (register_current_value[index] != register_new_value[index])
+        status = OPERATION_FAILED;
+    if (rtc->bus_status != OPERATION_DONE)
+      status = OPERATION_FAILED;
+#if DS1307_DRIFT_TRIM
+    if (status == OPERATION_DONE)
+      trim_rebase(rtc, register_new_value);
+#endif
+  }
+  if ((status == OPERATION_DONE) && !(register_new_value[DS1307_REGISTER_SECONDS] & (1 << DS1307_BIT_SETTING_CH)))
+  {
+    for (uint8_t index = 0; index < 7; index++)
+      rtc->now_anchor_time[index] = register_new_value[index];
+    BCD_to_HEX(rtc->now_anchor_time, 7);
+    rtc->now_anchor_tick = write_tick + write_latency;
+    rtc->now_anchor_ms = time_tick_ms() - ((time_tick_us() - rtc->now_anchor_tick) / 1000);
+    rtc->now_anchor_state = DS1307_NOW_EDGE_LOCKED;
+  }
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
+}
+
+/*one sample of the drift estimator, with a reference as DS1307_set_sync takes it (host time epoch and
+  microseconds at time_tick_us() == reference_tick). SECONDS is read back to back until it steps,
+  which puts the ds1307 time on a tick within one read, and the offset from the reference is taken
+  there. the first sample after a time write is the base, every sample at least DS1307_DRIFT_MIN_SPAN_S
+  after it stores the drift since the base into DS1307_REGISTER_TRIM. blocks for up to a second
+  with the bus busy, fails on a halted clock, more than 2000 s off the reference or with
+  DS1307_DRIFT_TRIM off*/
+uint8_t DS1307_drift_sample(ds1307_t *rtc, uint32_t epoch, uint32_t microseconds, uint32_t reference_tick)
+{
+#if DS1307_DRIFT_TRIM
+  uint8_t register_current_value[7];
+  uint8_t trim_image[5];
+  uint8_t first_seconds;
+  uint8_t status = OPERATION_FAILED;
+  uint32_t start_tick, previous_tick, current_tick, edge_tick;
+  uint32_t reference_us, reference_epoch, chip_epoch, span;
+  int32_t offset, trim;
+  DS1307_API_ENTER(rtc, STATS_READ);
+  start_tick = time_tick_us();
+  previous_tick = start_tick;
+  current_tick = start_tick;
+  register_read(rtc, DS1307_REGISTER_SECONDS, &first_seconds, 1);
+  register_current_value[DS1307_REGISTER_SECONDS] = first_seconds;
+  while ((rtc->bus_status == OPERATION_DONE) && !(first_seconds & (1 << DS1307_BIT_SETTING_CH)) && ((current_tick - start_tick) < 1100000))
+  {
+    current_tick = time_tick_us();
+    register_read(rtc, DS1307_REGISTER_SECONDS, register_current_value, 1);
+    if (register_current_value[DS1307_REGISTER_SECONDS] != first_seconds)
+      break;
+    previous_tick = current_tick;
   }
+  if ((rtc->bus_status == OPERATION_DONE) && (register_current_value[DS1307_REGISTER_SECONDS] != first_seconds))
+  {
+    /*ds1307 latches on START, the step came between the last two reads. the full time is read
+      right after it, still inside the new second*/
+    edge_tick = previous_tick + ((current_tick - previous_tick) >> 1);
+    register_read(rtc, DS1307_REGISTER_SECONDS, register_current_value, 7);
+    register_current_value[DS1307_REGISTER_HOURS] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+    BCD_to_HEX(register_current_value, 7);
+    chip_epoch = DS1307_EPOCH_2000 + time_to_seconds(register_current_value);
+    reference_us = microseconds + (edge_tick - reference_tick);
+    reference_epoch = epoch + (reference_us / 1000000);
+    if ((chip_epoch - reference_epoch + 2000) <= 4000)
+    {
+      offset = ((int32_t)(chip_epoch - reference_epoch) * 1000000) - (int32_t)(reference_us % 1000000);
+      status = OPERATION_DONE;
+      span = reference_epoch - rtc->drift_base_epoch;
+      if (rtc->drift_state != DS1307_DRIFT_BASE)
+      {
+        rtc->drift_base_epoch = reference_epoch;
+        rtc->drift_base_offset = offset;
+        rtc->drift_state = DS1307_DRIFT_BASE;
+      }
+      else if (span >= DS1307_DRIFT_MIN_SPAN_S)
+      {
+        /*microseconds gained per second is ppm, per half a second it is half ppm, rounded like the
+          correction so a drift just under a step is not cut down to the step below*/
+        trim = trim_round(offset - rtc->drift_base_offset, (int32_t)(span >> 1));
+        if (trim > DS1307_TRIM_LIMIT)
+          trim = DS1307_TRIM_LIMIT;
+        if (trim < -DS1307_TRIM_LIMIT)
+          trim = -DS1307_TRIM_LIMIT;
+        /*a clock never set by this driver is taken as right at the base*/
+        trim_load(rtc);
+        if (rtc->trim_anchor == 0)
+          rtc->trim_anchor = rtc->drift_base_epoch;
+        trim_image[0] = (uint8_t)trim;
+        for (uint8_t index = 0; index < 4; index++)
+          trim_image[index + 1] = (uint8_t)(rtc->trim_anchor >> (index << 3));
+        register_write(rtc, DS1307_REGISTER_TRIM, trim_image, 5);
+        rtc->trim = (int8_t)trim;
+        rtc->trim_state = DS1307_TRIM_LOADED;
+      }
+    }
+  }
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
+#else
+  (void)rtc;
+  (void)epoch;
+  (void)microseconds;
+  (void)reference_tick;
   return OPERATION_FAILED;
+#endif
+}
+
+/*the stored drift of ds1307 in half ppm, positive when it runs fast. 0 with DS1307_DRIFT_TRIM off*/
+int8_t DS1307_drift_trim(ds1307_t *rtc)
+{
+#if DS1307_DRIFT_TRIM
+  int8_t trim;
+  DS1307_API_ENTER(rtc, STATS_READ);
+  trim_load(rtc);
+  trim = rtc->trim;
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    trim = 0;
+  return trim;
+#else
+  (void)rtc;
+  return 0;
+#endif
 }
 
+/*returns the current time in data_array[7] without touching the bus. one full read of ds1307 is
+  anchored to time_tick_us() and the time is extrapolated from there, a new read is only made when
+  there is no anchor or the anchor is older than DS1307_NOW_RESYNC_MS. the age is taken from
+  time_tick_ms(), so a handle left alone for longer than the 71 minute wrap of time_tick_us reads
+  ds1307 again (up to the 49 day wrap of time_tick_ms). fails if the clock is halted*/
+uint8_t DS1307_now(ds1307_t *rtc, uint8_t *data_array)
+{
+  uint8_t status = OPERATION_DONE;
+  uint32_t tick, tick_ms;
+  DS1307_API_ENTER(rtc, STATS_NOW);
+  tick = time_tick_us();
+  tick_ms = time_tick_ms();
+  if ((rtc->now_anchor_state == DS1307_NOW_UNANCHORED) || ((tick_ms - rtc->now_anchor_ms) >= DS1307_NOW_RESYNC_MS))
+  {
+    status = now_resync(rtc);
+    tick = time_tick_us();
+    tick_ms = time_tick_ms();
+  }
+  if (status == OPERATION_DONE)
+  {
+    for (uint8_t index = 0; index < 7; index++)
+      data_array[index] = rtc->now_anchor_time[index];
+    time_advance(data_array, now_elapsed(rtc, tick, tick_ms, 0));
+  }
+  DS1307_API_EXIT(rtc);
+  return status;
+}
+
+/*forces a new anchor read for DS1307_now. an anchor locked to the 1hz edge keeps its sub-second phase*/
+uint8_t DS1307_now_resync(ds1307_t *rtc)
+{
+  uint8_t status;
+  DS1307_API_ENTER(rtc, STATS_NOW);
+  status = now_resync(rtc);
+  if (DS1307_API_EXIT(rtc) != OPERATION_DONE)
+    status = OPERATION_FAILED;
+  return status;
+}
+
+/*to be called from the interrupt of the 1hz square wave (DS1307_square_wave(WAVE_1)), on the falling
+  edge where ds1307 increments its seconds. moves the anchor onto the edge so DS1307_now changes
+  second exactly with ds1307. no bus access, does nothing until DS1307_now has an anchor.
+  does not take the handle lock, keep DS1307_now calls of the same handle out of this interrupt*/
+void DS1307_now_edge(ds1307_t *rtc)
+{
+  uint32_t tick = time_tick_us();
+  uint32_t tick_ms = time_tick_ms();
+  if (rtc->now_anchor_state == DS1307_NOW_UNANCHORED)
+    return;
+  /*an anchor read at an unknown point of its second has seen every edge up to the last whole second
+    since, this one is the next. once locked, the anchor sits on an edge and the elapsed time is a
+    whole number of seconds, rounding takes away the latency of the interrupt*/
+  if (rtc->now_anchor_state == DS1307_NOW_EDGE_LOCKED)
+    time_advance(rtc->now_anchor_time, now_elapsed(rtc, tick, tick_ms, 500000));
+  else
+    time_advance(rtc->now_anchor_time, now_elapsed(rtc, tick, tick_ms, 0) + 1);
+  rtc->now_anchor_tick = tick;
+  rtc->now_anchor_ms = tick_ms;
+  rtc->now_anchor_state = DS1307_NOW_EDGE_LOCKED;
+}
+
+/*drops every cached register and the copy of the snapshot ring, to be called whenever something
+  other than this driver may have written to ds1307 (another bus master, a battery swap)*/
+void DS1307_cache_invalidate(ds1307_t *rtc)
+{
+  DS1307_API_ENTER(rtc, STATS_CACHE);
+  rtc->snapshot_state = DS1307_SNAPSHOT_UNLOADED;
+#if DS1307_DRIFT_TRIM
+  rtc->trim_state = DS1307_TRIM_UNLOADED;
+#endif
+#if DS1307_SHADOW_CACHE
+  for (uint8_t index = 0; index < sizeof(rtc->shadow_valid); index++)
+    rtc->shadow_valid[index] = 0X00;
+#endif
+  DS1307_API_EXIT(rtc);
+}
+
+/*reloads the whole 64 byte register file into the cache, so following run/set/reset calls need no reads*/
+uint8_t DS1307_cache_refresh(ds1307_t *rtc)
+{
+#if DS1307_SHADOW_CACHE
+  uint8_t register_file[DS1307_REGISTER_FILE_SIZE];
+  DS1307_API_ENTER(rtc, STATS_CACHE);
+  register_read(rtc, DS1307_TIMEKEEPER_REGISTERS_START, register_file, DS1307_REGISTER_FILE_SIZE);
+  return DS1307_API_EXIT(rtc);
+#else
+  (void)rtc;
+  return OPERATION_DONE;
+#endif
+}
+
+/*bus status of the last api call on this handle, OPERATION_DONE or OPERATION_FAILED. for the calls
+  that return something other than a status (DS1307_run_state, DS1307_init_status_report,
+  DS1307_snapshot_count, DS1307_drift_trim)*/
+uint8_t DS1307_last_status(ds1307_t *rtc)
+{
+  return rtc->bus_status;
+}
+
+/*copies the counters of every public api of this handle into stats_array[STATS_API_COUNT], indexed by
+  enum ds1307_api. work done inside an api call for another one (DS1307_init running the clock) is
+  charged to the api that was called*/
+void DS1307_stats_dump(ds1307_t *rtc, struct ds1307_stats *stats_array)
+{
+#if DS1307_STATS
+  DS1307_API_ENTER(rtc, STATS_API_COUNT);
+  for (uint8_t index = 0; index < STATS_API_COUNT; index++)
+    stats_array[index] = rtc->stats_table[index];
+  DS1307_API_EXIT(rtc);
+#else
+  (void)rtc;
+  (void)stats_array;
+#endif
+}
 
-/*high level function to save a snapshot of all the time and control registers to ds1307 RAM.
-  there is only one slot for time snapshot, and a new save clears the last snapshot.*/
-void DS1307_snapshot_save()
+/*clears all the counters of this handle*/
+void DS1307_stats_reset(ds1307_t *rtc)
+{
+#if DS1307_STATS
+  uint8_t *stats_byte = (uint8_t *)rtc->stats_table;
+  DS1307_API_ENTER(rtc, STATS_API_COUNT);
+  for (uint16_t index = 0; index < sizeof(rtc->stats_table); index++)
+    stats_byte[index] = 0X00;
+  DS1307_API_EXIT(rtc);
+#else
+  (void)rtc;
+#endif
+}
+
+#if DS1307_ASYNC
+/*non-blocking DS1307_read. posts the transactions and returns at once, data_array is filled just
+  before callback runs (or DS1307_async_poll stops returning DS1307_ASYNC_BUSY). fails if an async
+  call of this handle is still in flight. blocking calls must not be made on the handle meanwhile*/
+uint8_t DS1307_read_async(ds1307_t *rtc, uint8_t option, uint8_t *data_array, ds1307_callback_t callback, void *callback_context)
+{
+  return async_start(rtc, DS1307_ASYNC_JOB_READ, option, data_array, callback, callback_context);
+}
+
+/*non-blocking DS1307_set. data_array is copied before this returns and is left untouched. SECONDS
+  and the registers after it go out in one burst, with CH merged in*/
+uint8_t DS1307_set_async(ds1307_t *rtc, uint8_t option, uint8_t *data_array, ds1307_callback_t callback, void *callback_context)
+{
+  return async_start(rtc, DS1307_ASYNC_JOB_SET, option, data_array, callback, callback_context);
+}
+
+/*non-blocking DS1307_snapshot_save*/
+uint8_t DS1307_snapshot_save_async(ds1307_t *rtc, ds1307_callback_t callback, void *callback_context)
+{
+  return async_start(rtc, DS1307_ASYNC_JOB_SNAPSHOT, SNAPSHOT, 0, callback, callback_context);
+}
+
+/*DS1307_ASYNC_BUSY while an async call of this handle is in flight, then the result of the last one.
+  a transaction still not complete DS1307_I2C_TIMEOUT_US after it went to the bus (a lost interrupt, a
+  slave holding the bus) ends the call here with OPERATION_FAILED, after time_i2c_recover has freed
+  the bus and dropped it. so a call that is never completed is only over once it is polled*/
+uint8_t DS1307_async_poll(ds1307_t *rtc)
+{
+  if ((rtc->async_status == DS1307_ASYNC_BUSY) && rtc->async_count && ((time_tick_us() - rtc->async_submit_tick) > DS1307_I2C_TIMEOUT_US))
+  {
+    time_i2c_recover(rtc->bus);
+    DS1307_async_complete(rtc, OPERATION_FAILED);
+  }
+  return rtc->async_status;
+}
+
+/*to be called by the low level api (usually its i2c interrupt) when the transaction it got from
+  time_i2c_submit is over, status is OPERATION_DONE or OPERATION_FAILED. hands the next posted
+  transaction to the bus or moves the async call to its next step. does not take the handle lock*/
+void DS1307_async_complete(ds1307_t *rtc, uint8_t status)
+{
+  struct ds1307_transaction *transaction;
+  if (!rtc->async_count)
+    return;
+  transaction = &rtc->async_queue[rtc->async_head];
+  register_track(rtc, async_job_api[rtc->async_job], transaction->direction, transaction->register_address, transaction->data_array, transaction->data_length, status);
+  rtc->async_head = (rtc->async_head + 1) % DS1307_ASYNC_QUEUE_SIZE;
+  rtc->async_count--;
+  if (status != OPERATION_DONE)
+  {
+    async_finish(rtc, OPERATION_FAILED);
+    return;
+  }
+  if (!rtc->async_count)
+  {
+    status = async_advance(rtc);
+    if (status != DS1307_ASYNC_BUSY)
+    {
+      async_finish(rtc, status);
+      return;
+    }
+  }
+  /*last thing done here, a blocking low level api completes inside time_i2c_submit*/
+  async_submit(rtc);
+}
+#endif
+
+/*internal function related to this file and not accessible from outside*/
+static uint8_t run_update(ds1307_t *rtc, uint8_t run_state)
+{
+  uint8_t register_current_value, register_new_value;
+  if ((run_state != CLOCK_RUN) && (run_state != CLOCK_HALT))
+    return OPERATION_FAILED;
+  /*preserving the contents of SECONDS register and changing CH bit. the cached SECONDS value is
+    only exact while the clock is halted, a running clock has to be read back*/
+  if ((register_read_cached(rtc, DS1307_REGISTER_SECONDS, &register_current_value) == DS1307_CACHE_HIT) && !(register_current_value & (1 << DS1307_BIT_SETTING_CH)))
+    register_read(rtc, DS1307_REGISTER_SECONDS, &register_current_value, 1);
+  if (rtc->bus_status != OPERATION_DONE)
+    return OPERATION_FAILED;
+  if (run_state == CLOCK_RUN)
+  {
+    /*CH=0 runs the clock*/
+    register_new_value = register_current_value & (~(1 << DS1307_BIT_SETTING_CH));
+  }
+  else
+  {
+    /*CH=1 halts the clock*/
+    register_new_value = register_current_value | (1 << DS1307_BIT_SETTING_CH);
+  }
+  /*write the new value back to SECONDS register*/
+  register_write(rtc, DS1307_REGISTER_SECONDS, &register_new_value, 1);
+  return OPERATION_DONE;
+}
+
+/*internal function related to this file and not accessible from outside*/
+static uint8_t now_resync(ds1307_t *rtc)
+{
+  uint32_t tick = time_tick_us();
+  uint32_t tick_ms = time_tick_ms();
+  uint32_t phase;
+  if ((DS1307_burst_read(rtc, rtc->now_anchor_time, 7) == DS1307_IS_STOPPED) || (rtc->bus_status != OPERATION_DONE))
+  {
+    rtc->now_anchor_state = DS1307_NOW_UNANCHORED;
+    return OPERATION_FAILED;
+  }
+  BCD_to_HEX(rtc->now_anchor_time, 7);
+#if DS1307_DRIFT_TRIM
+  trim_time(rtc, rtc->now_anchor_time);
+#endif
+  /*the phase of a locked anchor is only known while time_tick_us has not wrapped since its edge*/
+  if ((rtc->now_anchor_state == DS1307_NOW_EDGE_LOCKED) && ((tick_ms - rtc->now_anchor_ms) < DS1307_NOW_TICK_SPAN_MS))
+  {
+    phase = (tick - rtc->now_anchor_tick) % 1000000;
+    tick -= phase;
+    tick_ms -= phase / 1000;
+  }
+  else
+    rtc->now_anchor_state = DS1307_NOW_ANCHORED;
+  rtc->now_anchor_tick = tick;
+  rtc->now_anchor_ms = tick_ms;
+  return OPERATION_DONE;
+}
+
+/*internal function related to this file and not accessible from outside. rounding_us is added
+  before the whole seconds are taken. time_tick_us is exact but wraps after 71 minutes, an older
+  anchor is aged by time_tick_ms*/
+static uint32_t now_elapsed(ds1307_t *rtc, uint32_t tick, uint32_t tick_ms, uint32_t rounding_us)
+{
+  uint32_t age_ms = tick_ms - rtc->now_anchor_ms;
+  if (age_ms < DS1307_NOW_TICK_SPAN_MS)
+    return ((tick - rtc->now_anchor_tick) + rounding_us) / 1000000;
+  return (age_ms + (rounding_us / 1000)) / 1000;
+}
+
+#if DS1307_ASYNC
+/*internal function related to this file and not accessible from outside. the handle lock only covers
+  setting the call up, the first transaction is submitted after it is released so a low level api
+  that completes at once can run the callback without the lock held. returns OPERATION_DONE once the
+  call is accepted, its result comes through the callback and DS1307_async_poll*/
+static uint8_t async_start(ds1307_t *rtc, uint8_t job, uint8_t option, uint8_t *data_array, ds1307_callback_t callback, void *callback_context)
+{
+  uint8_t status = OPERATION_FAILED;
+  uint8_t accepted = 0;
+  uint8_t register_address, data_length;
+  DS1307_API_ENTER(rtc, async_job_api[job]);
+  if ((rtc->async_status != DS1307_ASYNC_BUSY) && (async_span(option, &register_address, &data_length) == OPERATION_DONE) && !((job == DS1307_ASYNC_JOB_SET) && (option == SNAPSHOT)))
+  {
+    rtc->async_job = job;
+    rtc->async_step = 0;
+    rtc->async_option = option;
+    rtc->async_data_array = data_array;
+    rtc->async_callback = callback;
+    rtc->async_callback_context = callback_context;
+    rtc->async_head = 0;
+    rtc->async_count = 0;
+    if (job == DS1307_ASYNC_JOB_SET)
+    {
+      /*bcd copy of the new values, the caller keeps its array*/
+      for (uint8_t index = 0; index < data_length; index++)
+        rtc->async_buffer[index] = data_array[index];
+      if (option != CONTROL)
+        HEX_to_BCD(rtc->async_buffer, (data_length > 7) ? 7 : data_length);
+      if (option == HOUR)
+        rtc->async_buffer[0] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+      if ((option == TIME) || (option == ALL))
+        rtc->async_buffer[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+    }
+    rtc->async_status = DS1307_ASYNC_BUSY;
+    status = async_advance(rtc);
+    accepted = 1;
+  }
+  DS1307_API_EXIT(rtc);
+  if (!accepted)
+    return OPERATION_FAILED;
+  /*a call served from the handle (snapshot ring already loaded) is over without any bus traffic*/
+  if (status == DS1307_ASYNC_BUSY)
+    async_submit(rtc);
+  else
+    async_finish(rtc, status);
+  return OPERATION_DONE;
+}
+
+/*internal function related to this file and not accessible from outside. runs with no transaction of
+  the call left in the queue, posts the next ones and returns DS1307_ASYNC_BUSY, or returns the result*/
+static uint8_t async_advance(ds1307_t *rtc)
+{
+  uint8_t register_address, data_length, slot;
+  uint8_t *buffer = rtc->async_buffer;
+  /*async_start only takes options that have a span, this keeps the outputs defined all the same*/
+  if (async_span(rtc->async_option, &register_address, &data_length) != OPERATION_DONE)
+    return OPERATION_FAILED;
+  switch (rtc->async_job)
+  {
+    case DS1307_ASYNC_JOB_READ:
+      if (rtc->async_option == SNAPSHOT)
+      {
+        /*the ring is read into the handle once, the newest snapshot then comes from there*/
+        if ((rtc->async_step++ == 0) && (rtc->snapshot_state != DS1307_SNAPSHOT_LOADED))
+        {
+          async_post(rtc, DS1307_TRANSACTION_READ, DS1307_REGISTER_SNAPSHOT_HEAD, rtc->snapshot_image, DS1307_SNAPSHOT_IMAGE_SIZE);
+          return DS1307_ASYNC_BUSY;
+        }
+        snapshot_check(rtc);
+        return snapshot_decode(rtc, 0, rtc->async_data_array);
+      }
+      switch (rtc->async_step++)
+      {
+        case 0:
+#if DS1307_DRIFT_TRIM
+          if ((register_address == DS1307_REGISTER_SECONDS) && (data_length >= 7))
+            async_trim_post(rtc);
+#endif
+          async_post(rtc, DS1307_TRANSACTION_READ, register_address, buffer, data_length);
+          rtc->async_step = 2;
+          return DS1307_ASYNC_BUSY;
+        default:
+#if DS1307_ROLLOVER_CHECK
+          /*same guard as DS1307_burst_read: a read at 59 seconds is followed by rereads (steps 4 and on)
+            until two in a row agree, at most DS1307_ROLLOVER_REREADS of them*/
+          if ((data_length >= 7) && (rtc->async_step <= (2 + DS1307_ROLLOVER_REREADS)) &&
+              ((rtc->async_step == 3) ? ((buffer[0] & (~(1 << DS1307_BIT_SETTING_CH))) == DS1307_BCD_SECONDS_BOUNDARY) : !time_settled(rtc->async_previous, buffer)))
+          {
+            for (uint8_t index = 0; index < 7; index++)
+              rtc->async_previous[index] = buffer[index];
+            async_post(rtc, DS1307_TRANSACTION_READ, register_address, buffer, data_length);
+            return DS1307_ASYNC_BUSY;
+          }
+#endif
+          if ((register_address == DS1307_REGISTER_SECONDS) && (rtc->async_option != CONTROL))
+            buffer[0] &= (~(1 << DS1307_BIT_SETTING_CH));
+          if (rtc->async_option == HOUR)
+            buffer[0] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+          if (rtc->async_option != CONTROL)
+            BCD_to_HEX(buffer, (data_length > 7) ? 7 : data_length);
+#if DS1307_DRIFT_TRIM
+          if ((register_address == DS1307_REGISTER_SECONDS) && (data_length >= 7))
+          {
+            trim_unpack(rtc, rtc->async_trim_image);
+            trim_time(rtc, buffer);
+          }
+#endif
+          for (uint8_t index = 0; index < data_length; index++)
+            rtc->async_data_array[index] = buffer[index];
+          return OPERATION_DONE;
+      }
+    case DS1307_ASYNC_JOB_SET:
+      switch (rtc->async_step++)
+      {
+        case 0:
+          if (register_address == DS1307_REGISTER_SECONDS)
+          {
+#if DS1307_SHADOW_CACHE
+            /*CH of a cached SECONDS is exact, the read can be skipped*/
+            if (rtc->shadow_valid[0] & 0X01)
+              rtc->async_register = rtc->shadow_register[DS1307_REGISTER_SECONDS];
+            else
+#endif
+            {
+              async_post(rtc, DS1307_TRANSACTION_READ, DS1307_REGISTER_SECONDS, &rtc->async_register, 1);
+              return DS1307_ASYNC_BUSY;
+            }
+          }
+          /*fall through*/
+        case 1:
+          if (register_address == DS1307_REGISTER_SECONDS)
+            buffer[0] = (rtc->async_register & (1 << DS1307_BIT_SETTING_CH)) | (buffer[0] & (~(1 << DS1307_BIT_SETTING_CH)));
+          async_post(rtc, DS1307_TRANSACTION_WRITE, register_address, buffer, data_length);
+#if DS1307_DRIFT_TRIM
+          /*a full time (TIME or ALL) moves the trim anchor as the blocking calls do. the handle copy is
+            not compared first, the write over the anchor makes it be read again*/
+          if ((register_address == DS1307_REGISTER_SECONDS) && (data_length >= 7))
+          {
+            uint32_t anchor = trim_anchor_of(buffer);
+            for (uint8_t index = 0; index < 4; index++)
+              rtc->async_trim_image[index + 1] = (uint8_t)(anchor >> (index << 3));
+            async_post(rtc, DS1307_TRANSACTION_WRITE, DS1307_REGISTER_TRIM_ANCHOR, &rtc->async_trim_image[1], 4);
+          }
+#endif
+          rtc->async_step = 2;
+          return DS1307_ASYNC_BUSY;
+        default:
+          return OPERATION_DONE;
+      }
+    case DS1307_ASYNC_JOB_SNAPSHOT:
+      switch (rtc->async_step++)
+      {
+        case 0:
+          if (rtc->snapshot_state != DS1307_SNAPSHOT_LOADED)
+          {
+            async_post(rtc, DS1307_TRANSACTION_READ, DS1307_REGISTER_SNAPSHOT_HEAD, rtc->snapshot_image, DS1307_SNAPSHOT_IMAGE_SIZE);
+            return DS1307_ASYNC_BUSY;
+          }
+          /*fall through*/
+        case 1:
+          snapshot_check(rtc);
+#if DS1307_DRIFT_TRIM
+          async_trim_post(rtc);
+#endif
+          async_post(rtc, DS1307_TRANSACTION_READ, DS1307_REGISTER_SECONDS, buffer, 7);
+          rtc->async_step = 2;
+          return DS1307_ASYNC_BUSY;
+        case 2:
+          buffer[0] &= (~(1 << DS1307_BIT_SETTING_CH));
+          BCD_to_HEX(buffer, 7);
+#if DS1307_DRIFT_TRIM
+          trim_unpack(rtc, rtc->async_trim_image);
+          trim_time(rtc, buffer);
+#endif
+          slot = snapshot_append(rtc, buffer);
+          /*same order as DS1307_snapshot_save, the slot and then head and crc*/
+          async_post(rtc, DS1307_TRANSACTION_WRITE, DS1307_SNAPSHOT_RING_START + (slot * DS1307_SNAPSHOT_SLOT_SIZE), &rtc->snapshot_image[SNAPSHOT_SLOT_OFFSET(slot)], DS1307_SNAPSHOT_SLOT_SIZE);
+          async_post(rtc, DS1307_TRANSACTION_WRITE, DS1307_REGISTER_SNAPSHOT_HEAD, rtc->snapshot_image, 2);
+          return DS1307_ASYNC_BUSY;
+        default:
+          rtc->snapshot_state = DS1307_SNAPSHOT_LOADED;
+          return OPERATION_DONE;
+      }
+    default:
+      return OPERATION_FAILED;
+  }
+}
+
+/*internal function related to this file and not accessible from outside. the queue holds every
+  transaction one step of an async call posts, which is never more than DS1307_ASYNC_QUEUE_SIZE*/
+static void async_post(ds1307_t *rtc, uint8_t direction, uint8_t register_address, uint8_t *data_array, uint8_t data_length)
+{
+  struct ds1307_transaction *transaction = &rtc->async_queue[(rtc->async_head + rtc->async_count) % DS1307_ASYNC_QUEUE_SIZE];
+  transaction->rtc = rtc;
+  transaction->direction = direction;
+  transaction->device_address = rtc->address;
+  transaction->register_address = register_address;
+  transaction->data_array = data_array;
+  transaction->data_length = data_length;
+  rtc->async_count++;
+}
+
+/*internal function related to this file and not accessible from outside. the tick is taken first, a
+  blocking low level api completes inside time_i2c_submit*/
+static void async_submit(ds1307_t *rtc)
+{
+  rtc->async_submit_tick = time_tick_us();
+  time_i2c_submit(rtc->bus, &rtc->async_queue[rtc->async_head]);
+}
+
+/*internal function related to this file and not accessible from outside. the handle is free again
+  before the callback runs, so the callback can start the next async call*/
+static void async_finish(ds1307_t *rtc, uint8_t status)
+{
+  rtc->async_count = 0;
+  rtc->async_job = DS1307_ASYNC_JOB_NONE;
+  rtc->async_status = status;
+  if (rtc->async_callback)
+    rtc->async_callback(rtc, status, rtc->async_callback_context);
+}
+
+/*internal function related to this file and not accessible from outside*/
+static uint8_t async_span(uint8_t option, uint8_t *register_address, uint8_t *data_length)
+{
+  *register_address = DS1307_REGISTER_SECONDS;
+  *data_length = 1;
+  switch (option)
+  {
+    case SECOND:
+    case MINUTE:
+    case HOUR:
+    case DAY_OF_WEEK:
+    case DATE:
+    case MONTH:
+    case YEAR:
+    case CONTROL:
+      *register_address = option;        /*enum options follows the register map up to CONTROL*/
+      break;
+    case TIME:
+      *register_address = DS1307_REGISTER_SECONDS;
+      *data_length = 7;
+      break;
+    case ALL:
+      *register_address = DS1307_REGISTER_SECONDS;
+      *data_length = 8;
+      break;
+    case SNAPSHOT:
+      *register_address = DS1307_REGISTER_SNAPSHOT_HEAD;
+      *data_length = DS1307_SNAPSHOT_IMAGE_SIZE;
+      break;
+    default:
+      return OPERATION_FAILED;
+  }
+  return OPERATION_DONE;
+}
+#endif
+
+/*internal function related to this file and not accessible from outside. a failed transfer is tried
+  again up to DS1307_I2C_RETRIES times, each after time_i2c_recover. once a transfer of an api call
+  has failed, the rest of the call makes no bus traffic, so a call never takes longer than
+  (DS1307_I2C_RETRIES + 1) deadlines and recoveries and nothing read from a failed transfer is
+  written back*/
+static uint8_t register_read(ds1307_t *rtc, uint8_t register_address, uint8_t *data_array, uint8_t array_length)
+{
+  uint8_t status;
+  if (rtc->bus_status != OPERATION_DONE)
+    return OPERATION_FAILED;
+  for (uint8_t attempt = 0; ; attempt++)
+  {
+    if (array_length == 1)
+      status = time_i2c_read_single(rtc->bus, rtc->address, register_address, data_array);
+    else
+      status = time_i2c_read_multi(rtc->bus, rtc->address, register_address, data_array, array_length);
+    register_track(rtc, DS1307_STATS_API(rtc), DS1307_TRANSACTION_READ, register_address, data_array, array_length, status);
+    if ((status == OPERATION_DONE) || (attempt == DS1307_I2C_RETRIES))
+      break;
+    time_i2c_recover(rtc->bus);
+  }
+  rtc->bus_status = status;
+  return status;
+}
+
+/*internal function related to this file and not accessible from outside. same retry policy as
+  register_read, writes of whole registers can be repeated*/
+static uint8_t register_write(ds1307_t *rtc, uint8_t register_address, uint8_t *data_array, uint8_t array_length)
+{
+  uint8_t status;
+  if (rtc->bus_status != OPERATION_DONE)
+    return OPERATION_FAILED;
+  for (uint8_t attempt = 0; ; attempt++)
+  {
+    if (array_length == 1)
+      status = time_i2c_write_single(rtc->bus, rtc->address, register_address, data_array);
+    else
+      status = time_i2c_write_multi(rtc->bus, rtc->address, register_address, data_array, array_length);
+    register_track(rtc, DS1307_STATS_API(rtc), DS1307_TRANSACTION_WRITE, register_address, data_array, array_length, status);
+    if ((status == OPERATION_DONE) || (attempt == DS1307_I2C_RETRIES))
+      break;
+    time_i2c_recover(rtc->bus);
+  }
+  rtc->bus_status = status;
+  return status;
+}
+
+/*internal function related to this file and not accessible from outside. shared by the blocking
+  calls and the async engine, api is the enum ds1307_api entry the transfer is charged to. a failed
+  write may have landed in part, so it is tracked like a write that did*/
+static void register_track(ds1307_t *rtc, uint8_t api, uint8_t direction, uint8_t register_address, uint8_t *data_array, uint8_t array_length, uint8_t status)
+{
+  /*any write to the timekeeping registers moves the clock away from the DS1307_now anchor*/
+  if ((direction == DS1307_TRANSACTION_WRITE) && (register_address <= DS1307_REGISTER_YEAR))
+  {
+    rtc->now_anchor_state = DS1307_NOW_UNANCHORED;
+#if DS1307_DRIFT_TRIM
+    rtc->drift_state = DS1307_DRIFT_NO_BASE;
+#endif
+  }
+#if DS1307_DRIFT_TRIM
+  /*a write over 0X3B to 0X3F (DS1307_ram_write included) changes the trim or its anchor: the copy is
+    read again before its next use, and the DS1307_now anchor, corrected by the old trim, is dropped.
+    the trim calls mark the copy loaded again after their own writes*/
+  if ((direction == DS1307_TRANSACTION_WRITE) && ((register_address + array_length) > DS1307_REGISTER_TRIM))
+  {
+    rtc->trim_state = DS1307_TRIM_UNLOADED;
+    rtc->now_anchor_state = DS1307_NOW_UNANCHORED;
+  }
+#endif
+  /*so does a write over the snapshot ring for its copy, the snapshot calls mark it loaded again*/
+  if ((direction == DS1307_TRANSACTION_WRITE) && (register_address <= DS1307_SNAPSHOT_RING_END) && ((register_address + array_length) > DS1307_REGISTER_SNAPSHOT_HEAD))
+    rtc->snapshot_state = DS1307_SNAPSHOT_UNLOADED;
+#if DS1307_STATS
+  if (api < STATS_API_COUNT)
+  {
+    rtc->stats_table[api].transactions++;
+    rtc->stats_table[api].bytes_written++;        /*register pointer*/
+    if (direction == DS1307_TRANSACTION_WRITE)
+      rtc->stats_table[api].bytes_written += array_length;
+    else
+      rtc->stats_table[api].bytes_read += array_length;
+  }
+#else
+  (void)api;
+#endif
+#if DS1307_SHADOW_CACHE
+  /*nothing is known of the registers a failed transfer covers*/
+  for (uint8_t index = 0; index < array_length; index++, register_address++)
+  {
+    rtc->shadow_register[register_address] = data_array[index];
+    if (status == OPERATION_DONE)
+      rtc->shadow_valid[register_address >> 3] |= (1 << (register_address & 0X07));
+    else
+      rtc->shadow_valid[register_address >> 3] &= (~(1 << (register_address & 0X07)));
+  }
+#else
+  (void)data_array;
+  (void)status;
+#endif
+}
+
+/*internal function related to this file and not accessible from outside. api is the enum ds1307_api
+  entry the bus traffic of this call is charged to, STATS_API_COUNT charges nothing*/
+static uint32_t api_enter(ds1307_t *rtc, uint8_t api)
+{
+  if (rtc->lock)
+    rtc->lock(rtc->lock_context);
+  rtc->bus_status = OPERATION_DONE;
+#if DS1307_STATS
+  rtc->stats_api = api;
+  if (api < STATS_API_COUNT)
+    rtc->stats_table[api].calls++;
+  return time_tick_us();
+#else
+  (void)api;
+  return 0;
+#endif
+}
+
+/*internal function related to this file and not accessible from outside. bucket n of the histogram
+  counts calls of 2^n to 2^(n+1)-1 microseconds, the last bucket everything longer*/
+static uint8_t api_exit(ds1307_t *rtc, uint32_t start_tick)
+{
+  uint8_t status = rtc->bus_status;
+  /*state worked out from a call that lost the bus is not trusted, it is read again next time*/
+  if (status != OPERATION_DONE)
+  {
+    rtc->snapshot_state = DS1307_SNAPSHOT_UNLOADED;
+    rtc->now_anchor_state = DS1307_NOW_UNANCHORED;
+    rtc->epoch_date[0] = 0X00;
+#if DS1307_DRIFT_TRIM
+    rtc->trim_state = DS1307_TRIM_UNLOADED;
+    rtc->drift_state = DS1307_DRIFT_NO_BASE;
+#endif
+  }
+#if DS1307_STATS
+  uint32_t latency = time_tick_us() - start_tick;
+  uint8_t bucket = 0;
+  while ((latency >>= 1) && (bucket < (DS1307_STATS_BUCKETS - 1)))
+    bucket++;
+  if (rtc->stats_api < STATS_API_COUNT)
+    rtc->stats_table[rtc->stats_api].latency_histogram[bucket]++;
+#else
+  (void)start_tick;
+#endif
+  if (rtc->unlock)
+    rtc->unlock(rtc->lock_context);
+  return status;
+}
+
+/*internal function related to this file and not accessible from outside. only the control bits of a
+  cached timekeeping register are trusted (CH in SECONDS), the time itself moves on without us*/
+static uint8_t register_read_cached(ds1307_t *rtc, uint8_t register_address, uint8_t *data_byte)
+{
+#if DS1307_SHADOW_CACHE
+  if (rtc->shadow_valid[register_address >> 3] & (1 << (register_address & 0X07)))
+  {
+    *data_byte = rtc->shadow_register[register_address];
+    return DS1307_CACHE_HIT;
+  }
+#endif
+  register_read(rtc, register_address, data_byte, 1);
+  return DS1307_CACHE_MISS;
+}
+
+/*internal function related to this file and not accessible from outside. ds1307 copies the time into
+  its user buffers on every i2c START, so one burst from SECONDS always returns a consistent time,
+  where a separate read of SECONDS could be torn by a rollover before the MINUTES read*/
+static uint8_t DS1307_burst_read(ds1307_t *rtc, uint8_t *data_array, uint8_t array_length)
+{
+  uint8_t run_state;
+  register_read(rtc, DS1307_REGISTER_SECONDS, data_array, array_length);
+#if DS1307_ROLLOVER_CHECK
+  /*seconds at the rollover boundary: a clone that does not latch can return 59 seconds with the next
+    minute. the time is read again until two reads in a row agree from MINUTES to YEAR, only one of
+    them can be torn by the rollover, so the last one is kept*/
+  if ((data_array[0] & (~(1 << DS1307_BIT_SETTING_CH))) == DS1307_BCD_SECONDS_BOUNDARY)
+  {
+    uint8_t previous_array[7];
+    for (uint8_t reread = 0; reread < DS1307_ROLLOVER_REREADS; reread++)
+    {
+      for (uint8_t index = 0; index < 7; index++)
+        previous_array[index] = data_array[index];
+      register_read(rtc, DS1307_REGISTER_SECONDS, data_array, array_length);
+      if (time_settled(previous_array, data_array))
+        break;
+    }
+  }
+#endif
+  run_state = (data_array[0] & (1 << DS1307_BIT_SETTING_CH)) ? DS1307_IS_STOPPED : DS1307_IS_RUNNING;
+  data_array[0] &= (~(1 << DS1307_BIT_SETTING_CH));
+  return run_state;
+}
+
+/*internal function related to this file and not accessible from outside. one burst of head, crc and
+  ring, skipped while the handle copy is loaded*/
+static void snapshot_load(ds1307_t *rtc)
+{
+  if (rtc->snapshot_state == DS1307_SNAPSHOT_LOADED)
+    return;
+  register_read(rtc, DS1307_REGISTER_SNAPSHOT_HEAD, rtc->snapshot_image, DS1307_SNAPSHOT_IMAGE_SIZE);
+  snapshot_check(rtc);
+}
+
+/*internal function related to this file and not accessible from outside. ram that was never written
+  by this ring layout (or a torn save over a full ring) fails the check and reads as an empty ring*/
+static void snapshot_check(ds1307_t *rtc)
+{
+  uint8_t head = rtc->snapshot_image[0];
+  if (((head >> 4) > DS1307_SNAPSHOT_SLOTS) || ((head & 0X0F) >= DS1307_SNAPSHOT_SLOTS) || (snapshot_crc(rtc->snapshot_image) != rtc->snapshot_image[1]))
+  {
+    rtc->snapshot_image[0] = 0X00;
+    rtc->snapshot_image[1] = snapshot_crc(rtc->snapshot_image);
+  }
+  rtc->snapshot_state = DS1307_SNAPSHOT_LOADED;
+}
+
+/*internal function related to this file and not accessible from outside*/
+static uint8_t snapshot_append(ds1307_t *rtc, const uint8_t *data_array)
+{
+  uint8_t count = rtc->snapshot_image[0] >> 4;
+  uint8_t slot = rtc->snapshot_image[0] & 0X0F;
+  uint32_t seconds = time_to_seconds(data_array);
+  for (uint8_t index = 0; index < DS1307_SNAPSHOT_SLOT_SIZE; index++, seconds >>= 8)
+    rtc->snapshot_image[SNAPSHOT_SLOT_OFFSET(slot) + index] = (uint8_t)seconds;
+  if (count < DS1307_SNAPSHOT_SLOTS)
+    count++;
+  rtc->snapshot_image[0] = (count << 4) | ((slot + 1) % DS1307_SNAPSHOT_SLOTS);
+  rtc->snapshot_image[1] = snapshot_crc(rtc->snapshot_image);
+  return slot;
+}
+
+/*internal function related to this file and not accessible from outside*/
+static uint8_t snapshot_decode(ds1307_t *rtc, uint8_t index, uint8_t *data_array)
+{
+  uint8_t slot;
+  uint32_t seconds = 0;
+  if (index >= (rtc->snapshot_image[0] >> 4))
+    return OPERATION_FAILED;
+  slot = ((rtc->snapshot_image[0] & 0X0F) + (DS1307_SNAPSHOT_SLOTS - 1) - index) % DS1307_SNAPSHOT_SLOTS;
+  for (int8_t byte_index = (DS1307_SNAPSHOT_SLOT_SIZE - 1); byte_index >= 0; byte_index--)
+    seconds = (seconds << 8) | rtc->snapshot_image[SNAPSHOT_SLOT_OFFSET(slot) + byte_index];
+  seconds_to_time(seconds, data_array);
+  return OPERATION_DONE;
+}
+
+/*internal function related to this file and not accessible from outside. crc-8 (polynomial 0X31,
+  msb first) of the head byte and then the live slots from the oldest, so free slots do not count*/
+static uint8_t snapshot_crc(const uint8_t *snapshot_image)
+{
+  uint8_t crc = DS1307_SNAPSHOT_CRC_INIT;
+  uint8_t count = snapshot_image[0] >> 4;
+  uint8_t oldest_slot;
+  if (count > DS1307_SNAPSHOT_SLOTS)
+    count = 0;
+  oldest_slot = ((snapshot_image[0] & 0X0F) + DS1307_SNAPSHOT_SLOTS - count) % DS1307_SNAPSHOT_SLOTS;
+  for (int16_t index = -1; index < (count * DS1307_SNAPSHOT_SLOT_SIZE); index++)
+  {
+    if (index < 0)
+      crc ^= snapshot_image[0];
+    else
+      crc ^= snapshot_image[SNAPSHOT_SLOT_OFFSET((oldest_slot + (index / DS1307_SNAPSHOT_SLOT_SIZE)) % DS1307_SNAPSHOT_SLOTS) + (index % DS1307_SNAPSHOT_SLOT_SIZE)];
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc & 0X80) ? ((crc << 1) ^ DS1307_SNAPSHOT_CRC_POLYNOMIAL) : (crc << 1);
+  }
+  return crc;
+}
+
+/*internal function related to this file and not accessible from outside. decoded 24 hour time, 2000
+  to 2099 where every year divisible by 4 is leap*/
+static uint32_t time_to_seconds(const uint8_t *data_array)
+{
+  return ((uint32_t)days_from_civil(data_array[6], data_array[5], data_array[4]) * 86400UL) + (data_array[2] * 3600UL) + (data_array[1] * 60) + data_array[0];
+}
+
+/*internal function related to this file and not accessible from outside. no loops: the year comes
+  from the 4 year cycle (1461 days, 2000 is its leap year) and the month from an estimate of 31 days
+  per month that is at most one month short. 2000-01-01 is a saturday*/
+static void seconds_to_time(uint32_t seconds, uint8_t *data_array)
+{
+  uint32_t days = seconds / 86400UL;
+  uint16_t cycle_day = days % 1461;
+  uint16_t day_of_year;
+  uint8_t year, month, leap;
+  seconds %= 86400UL;
+  data_array[0] = seconds % 60;
+  data_array[1] = (seconds / 60) % 60;
+  data_array[2] = seconds / 3600;
+  data_array[3] = ((days + 6) % 7) + 1;
+  year = ((days / 1461) << 2) + ((cycle_day ? (cycle_day - 1) : 0) / 365);
+  leap = !(year & 0X03);
+  day_of_year = days - days_from_civil(year, 1, 1);
+  month = day_of_year / 31;
+  if ((month < 11) && (day_of_year >= (days_before_month[month + 1] + (leap && (month >= 1)))))
+    month++;
+  data_array[4] = day_of_year - (days_before_month[month] + (leap && (month >= 2))) + 1;
+  data_array[5] = month + 1;
+  data_array[6] = year % 100;
+}
+
+/*internal function related to this file and not accessible from outside. (year + 3) / 4 leap days
+  have passed before january 1st of year, one more after february of a leap year*/
+static uint16_t days_from_civil(uint8_t year, uint8_t month, uint8_t date)
+{
+  return (365 * year) + ((year + 3) >> 2) + days_before_month[month - 1] + ((month > 2) && !(year & 0X03)) + date - 1;
+}
+
+/*internal function related to this file and not accessible from outside. data_array is bcd seconds
+  to year, the CH bit of SECONDS is merged in so the run state is kept*/
+static void time_write(ds1307_t *rtc, uint8_t *data_array)
+{
+  uint8_t register_current_value;
+  register_read_cached(rtc, DS1307_REGISTER_SECONDS, &register_current_value);
+  if (rtc->bus_status != OPERATION_DONE)
+    return;
+  data_array[0] = (register_current_value & (1 << DS1307_BIT_SETTING_CH)) | (data_array[0] & (~(1 << DS1307_BIT_SETTING_CH)));
+  data_array[2] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+  register_write(rtc, DS1307_REGISTER_SECONDS, data_array, 7);
+#if DS1307_DRIFT_TRIM
+  trim_rebase(rtc, data_array);
+#endif
+}
+
+/*internal function related to this file and not accessible from outside. option indexes the
+  register it belongs to, CH is left clear (stage_write merges it) and hours are kept in 24 hours mode*/
+static void stage_field(uint8_t *register_image, uint8_t option, uint8_t value)
+{
+  if (option != CONTROL)
+    HEX_to_BCD(&value, 1);
+  if (option == SECOND)
+    value &= (~(1 << DS1307_BIT_SETTING_CH));
+  else if (option == HOUR)
+    value &= (~(1 << DS1307_BIT_SETTING_AMPM));
+  register_image[option] = value;
+}
+
+/*internal function related to this file and not accessible from outside. register_image holds SECONDS
+  to CONTROL, bit n of dirty_mask marks register n. registers in between two runs are never written,
+  their current value is not known without reading them*/
+static void stage_write(ds1307_t *rtc, uint8_t *register_image, uint8_t dirty_mask)
+{
+  uint8_t register_current_value;
+  uint8_t run_start;
+  uint8_t index = DS1307_REGISTER_SECONDS;
+  if (dirty_mask & (1 << DS1307_REGISTER_SECONDS))
+  {
+    register_read_cached(rtc, DS1307_REGISTER_SECONDS, &register_current_value);
+    if (rtc->bus_status != OPERATION_DONE)
+      return;
+    register_image[DS1307_REGISTER_SECONDS] |= register_current_value & (1 << DS1307_BIT_SETTING_CH);
+  }
+  while (index <= DS1307_REGISTER_CONTROL)
+  {
+    if (!(dirty_mask & (1 << index)))
+    {
+      index++;
+      continue;
+    }
+    run_start = index;
+    while ((index <= DS1307_REGISTER_CONTROL) && (dirty_mask & (1 << index)))
+      index++;
+    register_write(rtc, run_start, &register_image[run_start], index - run_start);
+  }
+#if DS1307_DRIFT_TRIM
+  /*a full time is taken as right from here on*/
+  if ((dirty_mask & 0X7F) == 0X7F)
+    trim_rebase(rtc, register_image);
+#endif
+}
+
+#if DS1307_DRIFT_TRIM
+/*internal function related to this file and not accessible from outside*/
+static void trim_load(ds1307_t *rtc)
+{
+  uint8_t trim_image[5];
+  if (rtc->trim_state == DS1307_TRIM_LOADED)
+    return;
+  if (register_read(rtc, DS1307_REGISTER_TRIM, trim_image, 5) == OPERATION_DONE)
+    trim_unpack(rtc, trim_image);
+}
+
+/*internal function related to this file and not accessible from outside*/
+static void trim_unpack(ds1307_t *rtc, const uint8_t *trim_image)
+{
+  rtc->trim = (int8_t)trim_image[0];
+  rtc->trim_anchor = 0;
+  for (uint8_t index = 0; index < 4; index++)
+    rtc->trim_anchor |= (uint32_t)trim_image[index + 1] << (index << 3);
+  rtc->trim_state = DS1307_TRIM_LOADED;
+}
+
+#if DS1307_ASYNC
+/*internal function related to this file and not accessible from outside. a time read without a copy of
+  the trim in the handle reads it in the same step, otherwise the copy is packed so the job unpacks
+  the same image either way and never reads on the bus from its completion*/
+static void async_trim_post(ds1307_t *rtc)
+{
+  if (rtc->trim_state != DS1307_TRIM_LOADED)
+  {
+    async_post(rtc, DS1307_TRANSACTION_READ, DS1307_REGISTER_TRIM, rtc->async_trim_image, 5);
+    return;
+  }
+  rtc->async_trim_image[0] = (uint8_t)rtc->trim;
+  for (uint8_t index = 0; index < 4; index++)
+    rtc->async_trim_image[index + 1] = (uint8_t)(rtc->trim_anchor >> (index << 3));
+}
+#endif
+
+/*internal function related to this file and not accessible from outside. data_array is a decoded
+  24 hour time as DS1307_read(TIME) returns it. day of week is moved by the days the correction
+  crosses, so it keeps counting from whatever day the chip was set to*/
+static void trim_time(ds1307_t *rtc, uint8_t *data_array)
+{
+  uint32_t seconds, corrected;
+  int32_t day_shift;
+  uint8_t day_of_week = data_array[3];
+  trim_load(rtc);
+  if ((rtc->bus_status != OPERATION_DONE) || (rtc->trim_state != DS1307_TRIM_LOADED) || (rtc->trim == 0))
+    return;
+  seconds = time_to_seconds(data_array);
+  corrected = trim_correct(rtc, DS1307_EPOCH_2000 + seconds) - DS1307_EPOCH_2000;
+  seconds_to_time(corrected, data_array);
+  day_shift = (int32_t)(corrected / 86400UL) - (int32_t)(seconds / 86400UL);
+  data_array[3] = (uint8_t)((((day_of_week - 1) + (day_shift % 7) + 7) % 7) + 1);
+}
+
+/*internal function related to this file and not accessible from outside. data_array is the bcd
+  SECONDS to YEAR image just written, only the anchor is written and only when it moves*/
+static void trim_rebase(ds1307_t *rtc, const uint8_t *data_array)
+{
+  uint8_t anchor_image[4];
+  uint32_t anchor = trim_anchor_of(data_array);
+  trim_load(rtc);
+  if (anchor == rtc->trim_anchor)
+    return;
+  for (uint8_t index = 0; index < 4; index++)
+    anchor_image[index] = (uint8_t)(anchor >> (index << 3));
+  register_write(rtc, DS1307_REGISTER_TRIM_ANCHOR, anchor_image, 4);
+  rtc->trim_anchor = anchor;
+  rtc->trim_state = DS1307_TRIM_LOADED;
+}
+
+/*internal function related to this file and not accessible from outside. CH and AMPM are left out*/
+static uint32_t trim_anchor_of(const uint8_t *data_array)
 {
   uint8_t data_array_temporary[7];
-  time_i2c_read_multi(DS1307_I2C_ADDRESS, DS1307_REGISTER_SECONDS, data_array_temporary, 7);
-  time_i2c_write_multi(DS1307_I2C_ADDRESS, DS1307_SNAP0_ADDRESS, data_array_temporary, 7);
-  snap0_vacancy = OCCUPIED;
-  time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SNAP0_VACANCY, &snap0_vacancy);
+  for (uint8_t index = 0; index < 7; index++)
+    data_array_temporary[index] = data_array[index];
+  data_array_temporary[DS1307_REGISTER_SECONDS] &= (~(1 << DS1307_BIT_SETTING_CH));
+  data_array_temporary[DS1307_REGISTER_HOURS] &= (~(1 << DS1307_BIT_SETTING_AMPM));
+  BCD_to_HEX(data_array_temporary, 7);
+  return DS1307_EPOCH_2000 + time_to_seconds(data_array_temporary);
 }
 
-/*high level function to clear the sapshot slot on ds1307 RAM*/
-void DS1307_snapshot_clear()
+/*internal function related to this file and not accessible from outside. the drift is
+  (epoch - anchor) * trim / 2000000 seconds, rounded to the nearest second. elapsed is split into
+  thousands of seconds and the rest, and the whole seconds of the thousands part are taken out before
+  the rest is added, so every product fits 32 bits and the rounding is exact*/
+static uint32_t trim_correct(ds1307_t *rtc, uint32_t epoch)
 {
-  snap0_vacancy = NOT_OCCUPIED;
-  time_i2c_write_single(DS1307_I2C_ADDRESS, DS1307_REGISTER_SNAP0_VACANCY, &snap0_vacancy);
+  int32_t elapsed, product, drift;
+  if ((rtc->trim == 0) || (rtc->trim_anchor == 0))
+    return epoch;
+  elapsed = (int32_t)(epoch - rtc->trim_anchor);
+  product = (elapsed / 1000) * rtc->trim;        /*in 1/2000 seconds*/
+  drift = (product / 2000) + trim_round(((product % 2000) * 1000) + ((elapsed % 1000) * rtc->trim), 2000000);
+  return epoch - (uint32_t)drift;
+}
+
+/*internal function related to this file and not accessible from outside. divisor is positive*/
+static int32_t trim_round(int32_t dividend, int32_t divisor)
+{
+  if (dividend < 0)
+    return -((-dividend + (divisor >> 1)) / divisor);
+  return (dividend + (divisor >> 1)) / divisor;
+}
+#endif
+
+#if DS1307_ROLLOVER_CHECK
+/*internal function related to this file and not accessible from outside. SECONDS is left out, it is
+  the one register that moves between two good reads*/
+static uint8_t time_settled(const uint8_t *previous_array, const uint8_t *data_array)
+{
+  for (uint8_t index = DS1307_REGISTER_MINUTES; index <= DS1307_REGISTER_YEAR; index++)
+    if (previous_array[index] != data_array[index])
+      return 0;
+  return 1;
+}
+#endif
+
+/*internal function related to this file and not accessible from outside. data_array holds decoded
+  seconds, minutes, hours, day of week, date, month and year (2000 to 2099, every 4th year is leap)*/
+static void time_advance(uint8_t *data_array, uint32_t seconds)
+{
+  uint8_t month_length;
+  seconds += data_array[0];
+  data_array[0] = seconds % 60;
+  seconds = (seconds / 60) + data_array[1];
+  data_array[1] = seconds % 60;
+  seconds = (seconds / 60) + data_array[2];
+  data_array[2] = seconds % 24;
+  seconds /= 24;        /*whole days left to add*/
+  data_array[3] = ((data_array[3] - 1 + seconds) % 7) + 1;
+  while (seconds)
+  {
+    month_length = days_in_month[data_array[5] - 1] + ((data_array[5] == 2) && !(data_array[6] & 0X03));
+    if ((data_array[4] + seconds) <= month_length)
+    {
+      data_array[4] += seconds;
+      break;
+    }
+    seconds -= (month_length - data_array[4]) + 1;
+    data_array[4] = 1;
+    if (++data_array[5] > 12)
+    {
+      data_array[5] = 1;
+      data_array[6] = (data_array[6] + 1) % 100;
+    }
+  }
 }
 
 /*internal function related to this file and not accessible from outside*/
 static void BCD_to_HEX(uint8_t *data_array, uint8_t array_length)
 {
+#if DS1307_BCD_CONVERSION == DS1307_BCD_SWAR
+  uint64_t packed, tens;
+  uint8_t chunk_length;
+  for (; array_length; array_length -= chunk_length, data_array += chunk_length)
+  {
+    /*up to 8 bytes per 64 bit word, every lane ends up at most 15 * 10 + 15 so no lane carries into the next*/
+    chunk_length = (array_length > 8) ? 8 : array_length;
+    packed = 0;
+    for (int8_t index = (chunk_length - 1); index >= 0; index--)
+      packed = (packed << 8) | data_array[index];
+    tens = (packed >> 4) & 0X0F0F0F0F0F0F0F0FULL;
+    packed = (packed & 0X0F0F0F0F0F0F0F0FULL) + (tens << 3) + (tens << 1);
+    for (uint8_t index = 0; index < chunk_length; index++, packed >>= 8)
+      data_array[index] = (uint8_t)packed;
+  }
+#elif DS1307_BCD_CONVERSION == DS1307_BCD_TABLE
+  for (int8_t index = (array_length - 1); index >= 0; index--)
+  {
+    data_array[index] = bcd_tens_table[data_array[index] >> 4] + (data_array[index] & 0X0F);
+  }
+#else
   for (int8_t index = (array_length - 1); index >= 0; index--)
   {
     data_array[index] = ((data_array[index] >> 4) << 1) + ((data_array[index] >> 4) << 3) + (data_array[index] & 0X0F);
   }
+#endif
 }
 
 /*internal function related to this file and not accessible from outside*/
 static void HEX_to_BCD(uint8_t *data_array, uint8_t array_length)
 {
+#if DS1307_BCD_CONVERSION == DS1307_BCD_SWAR
+  uint64_t packed, tens;
+  uint8_t chunk_length;
+  for (; array_length; array_length -= chunk_length, data_array += chunk_length)
+  {
+    /*4 bytes per 64 bit word in 16 bit lanes, x * 103 >> 10 is x / 10 for 0 to 99 and x * 103 fits a lane.
+      bcd is then x + 6 * (x / 10)*/
+    chunk_length = (array_length > 4) ? 4 : array_length;
+    packed = 0;
+    for (int8_t index = (chunk_length - 1); index >= 0; index--)
+      packed = (packed << 16) | data_array[index];
+    tens = ((packed * 103) >> 10) & 0X000F000F000F000FULL;
+    packed += (tens << 2) + (tens << 1);
+    for (uint8_t index = 0; index < chunk_length; index++, packed >>= 16)
+      data_array[index] = (uint8_t)packed;
+  }
+#elif DS1307_BCD_CONVERSION == DS1307_BCD_TABLE
+  for (int8_t index = (array_length - 1); index >= 0; index--)
+  {
+    if (data_array[index] < sizeof(hex_to_bcd_table))
+      data_array[index] = hex_to_bcd_table[data_array[index]];
+  }
+#else
   uint8_t temporary_value;
   for (int8_t index = (array_length - 1); index >= 0; index--)
   {
@@ -383,4 +1888,5 @@ static void HEX_to_BCD(uint8_t *data_array, uint8_t array_length)
     temporary_value += data_array[index];
     data_array[index] = temporary_value;
   }
+#endif
 }
@@ -2,8 +2,15 @@
 #ifndef RTC_DS1307_H
 #define RTC_DS1307_H
 
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 enum options {SECOND, MINUTE, HOUR, DAY_OF_WEEK, DATE, MONTH, YEAR, CONTROL, RAM, TIME, SNAPSHOT, ALL};
 enum square_wave {WAVE_OFF, WAVE_1, WAVE_2, WAVE_3, WAVE_4};
+enum ds1307_api {STATS_INIT, STATS_INIT_STATUS, STATS_RUN, STATS_RESET, STATS_READ, STATS_SET, STATS_SQUARE_WAVE, STATS_SNAPSHOT, STATS_RAM, STATS_CACHE, STATS_NOW, STATS_API_COUNT};
 enum ds1307_registers {
   DS1307_REGISTER_SECONDS, 
   DS1307_REGISTER_MINUTES, 
@@ -26,13 +33,45 @@ enum ds1307_registers {
 #define OPERATION_FAILED                      0X00
 #define DS1307_NOT_INITIALIZED                0X00
 #define DS1307_INITIALIZED                    0X2C
-#define OCCUPIED                              0X01
-#define NOT_OCCUPIED                          0X00
+#define DS1307_CACHE_HIT                      0X01
+#define DS1307_CACHE_MISS                     0X00
+#define DS1307_NOW_UNANCHORED                 0X00
+#define DS1307_NOW_ANCHORED                   0X01
+#define DS1307_NOW_EDGE_LOCKED                0X02
+#define DS1307_NOW_TICK_SPAN_MS               4000000        /*anchor age up to which time_tick_us has not wrapped (71.6 minutes)*/
+#define DS1307_BCD_LOOP                       0X00
+#define DS1307_BCD_TABLE                      0X01
+#define DS1307_BCD_SWAR                       0X02
+#define DS1307_STATS_BUCKETS                  16
+#define DS1307_SNAPSHOT_UNLOADED              0X00
+#define DS1307_SNAPSHOT_LOADED                0X01
+#define DS1307_ASYNC_BUSY                     0X02
+#define DS1307_TRANSACTION_READ               0X00
+#define DS1307_TRANSACTION_WRITE              0X01
+#define DS1307_ASYNC_JOB_NONE                 0X00
+#define DS1307_ASYNC_JOB_READ                 0X01
+#define DS1307_ASYNC_JOB_SET                  0X02
+#define DS1307_ASYNC_JOB_SNAPSHOT             0X03
+#define DS1307_TRIM_UNLOADED                  0X00
+#define DS1307_TRIM_LOADED                    0X01
+#define DS1307_DRIFT_NO_BASE                  0X00
+#define DS1307_DRIFT_BASE                     0X01
+#define DS1307_TRIM_LIMIT                     127        /*largest trim in half ppm, 63.5 ppm*/
 
 #define DS1307_REGISTER_INIT_STATUS           0X08
-#define DS1307_REGISTER_SNAP0_VACANCY         0X09
+#define DS1307_REGISTER_SNAPSHOT_HEAD         0X09        /*high nibble snapshot count, low nibble next slot*/
+#define DS1307_REGISTER_SNAPSHOT_CRC          0X0A        /*crc-8 of the head and the live slots, oldest first*/
+#define DS1307_SNAPSHOT_RING_START            0X0B
+#define DS1307_SNAPSHOT_SLOT_SIZE             4        /*seconds since 2000-01-01 00:00:00, little endian*/
+#define DS1307_SNAPSHOT_RING_END              (DS1307_SNAPSHOT_RING_START + (DS1307_SNAPSHOT_SLOTS * DS1307_SNAPSHOT_SLOT_SIZE) - 1)
+#define DS1307_SNAPSHOT_IMAGE_SIZE            (DS1307_SNAPSHOT_RING_END - DS1307_REGISTER_SNAPSHOT_HEAD + 1)
+#define DS1307_SNAPSHOT_CRC_POLYNOMIAL        0X31
+#define DS1307_SNAPSHOT_CRC_INIT              0XFF
+#define DS1307_REGISTER_TRIM                  0X3B        /*DS1307_DRIFT_TRIM: signed drift in half ppm, positive when ds1307 runs fast*/
+#define DS1307_REGISTER_TRIM_ANCHOR           0X3C        /*DS1307_DRIFT_TRIM: unix time of the last full time set, little endian, 0 for none*/
 #define DS1307_RAM_START                      0X08
 #define DS1307_RAM_END                        0X3F
+#define DS1307_RAM_SIZE                       (DS1307_RAM_END - DS1307_RAM_START + 1)
 #define DS1307_BIT_SETTING_CH                 0X07
 #define DS1307_BIT_SETTING_RS0                0X00
 #define DS1307_BIT_SETTING_RS1                0X01
@@ -50,24 +89,194 @@ enum ds1307_registers {
 #define DS1307_REGISTER_YEAR_DEFAULT          0X00
 #define DS1307_REGISTER_CONTROL_DEFAULT       0X00
 #define DS1307_RAM_BLOCK_DEFAULT              0x00
-#define DS1307_SNAP0_ADDRESS                  0X39
+#define DS1307_BCD_SECONDS_BOUNDARY           0X59
+#define DS1307_ROLLOVER_REREADS               3        /*rereads of DS1307_ROLLOVER_CHECK before the last read is taken as it is*/
+#define DS1307_REGISTER_FILE_SIZE             0X40
+#define DS1307_EPOCH_2000                     946684800UL        /*unix time of 2000-01-01 00:00:00*/
+#define DS1307_EPOCH_2100                     4102444800UL        /*unix time of 2100-01-01 00:00:00*/
+
+/*driver options, can be overridden from the compiler command line*/
+#ifndef DS1307_ROLLOVER_CHECK
+#define DS1307_ROLLOVER_CHECK                 0X00        /*0X01 rereads the time at 59 seconds until two reads agree (for clones without latched user buffers)*/
+#endif
+#ifndef DS1307_SHADOW_CACHE
+#define DS1307_SHADOW_CACHE                   0X00        /*0X01 keeps a write-through copy of all 64 registers, run/set/reset skip their reads*/
+#endif
+#ifndef DS1307_BCD_CONVERSION
+#define DS1307_BCD_CONVERSION                 DS1307_BCD_TABLE        /*DS1307_BCD_LOOP (smallest), DS1307_BCD_TABLE or DS1307_BCD_SWAR (64 bit cpus)*/
+#endif
+#ifndef DS1307_STATS
+#define DS1307_STATS                          0X00        /*0X01 counts transactions, bytes and latency of every api call, see DS1307_stats_dump*/
+#endif
+#ifndef DS1307_ASYNC
+#define DS1307_ASYNC                          0X00        /*0X01 adds the *_async calls, the low level api has to provide time_i2c_submit*/
+#endif
+#ifndef DS1307_ASYNC_QUEUE_SIZE
+#define DS1307_ASYNC_QUEUE_SIZE               4        /*transactions one async call can have posted at a time*/
+#endif
+#ifndef DS1307_SNAPSHOT_SLOTS
+#define DS1307_SNAPSHOT_SLOTS                 12        /*1 to 12, ram after the ring (from 0X0B + 4 * slots) is left to the user, up to 0X3A with DS1307_DRIFT_TRIM*/
+#endif
+#ifndef DS1307_DRIFT_TRIM
+#define DS1307_DRIFT_TRIM                     0X00        /*0X01 keeps a drift trim in 0X3B to 0X3F, time reads, read_epoch and now are corrected by it*/
+#endif
+#ifndef DS1307_DRIFT_MIN_SPAN_S
+#define DS1307_DRIFT_MIN_SPAN_S               21600        /*reference time between the first and a later DS1307_drift_sample before a trim is stored*/
+#endif
+#ifndef DS1307_I2C_TIMEOUT_US
+#define DS1307_I2C_TIMEOUT_US                 10000        /*longest a low level call may take before it gives up and returns OPERATION_FAILED*/
+#endif
+#ifndef DS1307_I2C_RETRIES
+#define DS1307_I2C_RETRIES                    2        /*transfers tried again after a failure and a time_i2c_recover, 0 for none*/
+#endif
+#ifndef DS1307_SYNC_LATENCY_MAX_US
+#define DS1307_SYNC_LATENCY_MAX_US            100000        /*measured write latency above which DS1307_set_sync fails, far above a few bus transactions*/
+#endif
+#ifndef DS1307_SYNC_PASSES
+#define DS1307_SYNC_PASSES                    4        /*times DS1307_set_sync works out the time again when it ran into the next second, before it fails*/
+#endif
+#ifndef DS1307_NOW_RESYNC_MS
+#define DS1307_NOW_RESYNC_MS                  60000        /*age of the DS1307_now anchor before it is read again, must stay under DS1307_NOW_TICK_SPAN_MS*/
+#endif
+
+struct ds1307_stats {
+  uint32_t calls;
+  uint32_t transactions;
+  uint32_t bytes_read;
+  uint32_t bytes_written;        /*register pointer bytes included*/
+  uint32_t latency_histogram[DS1307_STATS_BUCKETS];        /*log2 buckets of whole call latency in microseconds*/
+};
 
-uint8_t DS1307_run(uint8_t run_state);
-uint8_t DS1307_run_state(void);
-uint8_t DS1307_read(uint8_t registers, uint8_t *data_array);
-void DS1307_reset(uint8_t input);
-uint8_t DS1307_set(uint8_t registers, uint8_t *data_array);
-uint8_t DS1307_init(uint8_t *data_array, uint8_t run_state, uint8_t reset_state);
-uint8_t DS1307_init_status_report();
-void DS1307_init_status_update();
-uint8_t DS1307_square_wave(uint8_t input);
-void DS1307_snapshot_save();
-void DS1307_snapshot_clear();
+/*one i2c transfer of an async call, handed to time_i2c_submit. a read is register pointer write,
+  repeated start and data_length bytes of read, a write is register pointer and data_length bytes.
+  the descriptor stays valid until DS1307_async_complete(transaction->rtc, status) is called for it,
+  or until time_i2c_recover drops it when DS1307_async_poll gives up on it*/
+struct ds1307_transaction {
+  struct ds1307 *rtc;        /*handle that posted the transaction*/
+  uint8_t direction;        /*DS1307_TRANSACTION_READ or DS1307_TRANSACTION_WRITE*/
+  uint8_t device_address;
+  uint8_t register_address;
+  uint8_t data_length;
+  uint8_t *data_array;
+};
 
-void DS1307_I2C_init();
-void time_i2c_write_single(uint8_t device_address, uint8_t register_address, uint8_t data_byte);
-void time_i2c_write_multi(uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length);
-void time_i2c_read_single(uint8_t device_address, uint8_t register_address, uint8_t data_byte);
-void time_i2c_read_multi(uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length);
+/*called once an async call is finished, with OPERATION_DONE or OPERATION_FAILED. runs from wherever
+  DS1307_async_complete was called, often an interrupt*/
+typedef void (*ds1307_callback_t)(struct ds1307 *rtc, uint8_t status, void *callback_context);
+
+/*one handle per ds1307, every api call takes it. bus and address are set by DS1307_handle_init,
+  the lock hook by DS1307_lock_hook, everything else belongs to the driver*/
+typedef struct ds1307 {
+  void *bus;        /*handed to the low level api, for example a bus number or a peripheral*/
+  uint8_t address;        /*i2c address, DS1307_I2C_ADDRESS*/
+  void (*lock)(void *lock_context);        /*optional, taken around every api call*/
+  void (*unlock)(void *lock_context);
+  void *lock_context;
+  uint8_t now_anchor_time[7];        /*time read from ds1307 at now_anchor_tick, base of DS1307_now extrapolation*/
+  uint32_t now_anchor_tick;        /*time_tick_us() value that belongs to now_anchor_time*/
+  uint32_t now_anchor_ms;        /*time_tick_ms() value taken with now_anchor_tick, the age of the anchor past the wrap of time_tick_us*/
+  uint8_t now_anchor_state;        /*DS1307_NOW_UNANCHORED, DS1307_NOW_ANCHORED or DS1307_NOW_EDGE_LOCKED*/
+  uint8_t snapshot_image[DS1307_SNAPSHOT_IMAGE_SIZE];        /*copy of the snapshot head, crc and ring*/
+  uint8_t snapshot_state;        /*DS1307_SNAPSHOT_LOADED while snapshot_image mirrors ds1307*/
+  uint8_t epoch_date[3];        /*bcd date, month and year that epoch_days belongs to, 0 date for none*/
+  uint16_t epoch_days;        /*days from 2000-01-01 to epoch_date*/
+  uint8_t stage_register[8];        /*bcd values staged by DS1307_stage, SECONDS to CONTROL*/
+  uint8_t stage_dirty;        /*one bit per stage_register entry staged since DS1307_begin*/
+  uint8_t bus_status;        /*OPERATION_FAILED once a transfer of the current api call failed for good, see DS1307_last_status*/
+#if DS1307_DRIFT_TRIM
+  int8_t trim;        /*copy of DS1307_REGISTER_TRIM*/
+  uint32_t trim_anchor;        /*copy of DS1307_REGISTER_TRIM_ANCHOR*/
+  uint8_t trim_state;        /*DS1307_TRIM_LOADED while trim and trim_anchor mirror ds1307*/
+  uint8_t drift_state;        /*DS1307_DRIFT_BASE once DS1307_drift_sample has a first sample since the last time write*/
+  uint32_t drift_base_epoch;        /*reference unix time of the first sample*/
+  int32_t drift_base_offset;        /*ds1307 minus reference at the first sample, microseconds*/
+#endif
+#if DS1307_SHADOW_CACHE
+  uint8_t shadow_register[DS1307_REGISTER_FILE_SIZE];        /*write-through copy of the ds1307 register file and RAM*/
+  uint8_t shadow_valid[DS1307_REGISTER_FILE_SIZE >> 3];        /*one bit per shadow_register entry, set when the entry mirrors ds1307*/
+#endif
+#if DS1307_ASYNC
+  struct ds1307_transaction async_queue[DS1307_ASYNC_QUEUE_SIZE];        /*ring of posted transactions, the head one is on the bus*/
+  uint8_t async_head;        /*index of the oldest posted transaction*/
+  uint8_t async_count;        /*posted transactions not completed yet*/
+  uint32_t async_submit_tick;        /*time_tick_us when the head transaction went to the bus, for the DS1307_async_poll deadline*/
+  uint8_t async_job;        /*DS1307_ASYNC_JOB_*, the one async call of this handle in flight*/
+  uint8_t async_step;        /*state of the async call, advanced every time its posted transactions are done*/
+  uint8_t async_option;        /*option of DS1307_read_async or DS1307_set_async*/
+  uint8_t async_status;        /*DS1307_ASYNC_BUSY, or the result of the last async call*/
+  uint8_t async_register;        /*single byte transfer of the async call (SECONDS for CH)*/
+  uint8_t async_buffer[8];        /*bcd image of the registers the async call reads or writes*/
+#if DS1307_ROLLOVER_CHECK
+  uint8_t async_previous[7];        /*previous read of a time read at the rollover boundary*/
+#endif
+#if DS1307_DRIFT_TRIM
+  uint8_t async_trim_image[5];        /*trim and anchor for an async time read, anchor written after a full async time set*/
+#endif
+  uint8_t *async_data_array;        /*caller array, only touched when a read is done*/
+  ds1307_callback_t async_callback;
+  void *async_callback_context;
+#endif
+#if DS1307_STATS
+  struct ds1307_stats stats_table[STATS_API_COUNT];        /*one entry per public api, indexed by enum ds1307_api*/
+  uint8_t stats_api;        /*api that the bus traffic is charged to*/
+#endif
+} ds1307_t;
+
+void DS1307_handle_init(ds1307_t *rtc, void *bus, uint8_t address);
+void DS1307_lock_hook(ds1307_t *rtc, void (*lock)(void *lock_context), void (*unlock)(void *lock_context), void *lock_context);
+uint8_t DS1307_run(ds1307_t *rtc, uint8_t run_state);
+uint8_t DS1307_run_state(ds1307_t *rtc);
+uint8_t DS1307_read(ds1307_t *rtc, uint8_t registers, uint8_t *data_array);
+uint8_t DS1307_reset(ds1307_t *rtc, uint8_t input);
+uint8_t DS1307_set(ds1307_t *rtc, uint8_t registers, uint8_t *data_array);
+void DS1307_begin(ds1307_t *rtc);
+uint8_t DS1307_stage(ds1307_t *rtc, uint8_t option, uint8_t value);
+uint8_t DS1307_commit(ds1307_t *rtc);
+uint8_t DS1307_init(ds1307_t *rtc, uint8_t *data_array, uint8_t run_state, uint8_t reset_state);
+uint8_t DS1307_init_status_report(ds1307_t *rtc);
+uint8_t DS1307_init_status_update(ds1307_t *rtc);
+uint8_t DS1307_square_wave(ds1307_t *rtc, uint8_t input);
+uint8_t DS1307_snapshot_save(ds1307_t *rtc);
+uint8_t DS1307_snapshot_read(ds1307_t *rtc, uint8_t index, uint8_t *data_array);
+uint8_t DS1307_snapshot_count(ds1307_t *rtc);
+uint8_t DS1307_ram_read(ds1307_t *rtc, uint8_t offset, uint8_t *data_array, uint8_t length);
+uint8_t DS1307_ram_write(ds1307_t *rtc, uint8_t offset, uint8_t *data_array, uint8_t length);
+uint8_t DS1307_snapshot_clear(ds1307_t *rtc);
+void DS1307_cache_invalidate(ds1307_t *rtc);
+uint8_t DS1307_cache_refresh(ds1307_t *rtc);
+uint8_t DS1307_read_epoch(ds1307_t *rtc, uint32_t *epoch);
+uint8_t DS1307_set_epoch(ds1307_t *rtc, uint32_t epoch);
+uint8_t DS1307_set_sync(ds1307_t *rtc, uint32_t epoch, uint32_t microseconds, uint32_t reference_tick);
+uint8_t DS1307_drift_sample(ds1307_t *rtc, uint32_t epoch, uint32_t microseconds, uint32_t reference_tick);
+int8_t DS1307_drift_trim(ds1307_t *rtc);
+uint8_t DS1307_now(ds1307_t *rtc, uint8_t *data_array);
+uint8_t DS1307_now_resync(ds1307_t *rtc);
+void DS1307_now_edge(ds1307_t *rtc);
+void DS1307_stats_dump(ds1307_t *rtc, struct ds1307_stats *stats_array);
+void DS1307_stats_reset(ds1307_t *rtc);
+uint8_t DS1307_last_status(ds1307_t *rtc);
+uint8_t DS1307_read_async(ds1307_t *rtc, uint8_t option, uint8_t *data_array, ds1307_callback_t callback, void *callback_context);
+uint8_t DS1307_set_async(ds1307_t *rtc, uint8_t option, uint8_t *data_array, ds1307_callback_t callback, void *callback_context);
+uint8_t DS1307_snapshot_save_async(ds1307_t *rtc, ds1307_callback_t callback, void *callback_context);
+uint8_t DS1307_async_poll(ds1307_t *rtc);
+void DS1307_async_complete(ds1307_t *rtc, uint8_t status);
+
+/*low level api. every transfer returns OPERATION_FAILED on a NACK, a lost arbitration or a bus held
+  low, and returns within DS1307_I2C_TIMEOUT_US whatever the slave does. time_i2c_recover frees a bus
+  that a slave holds low (clocks SCL until SDA is released, then a STOP) and drops a submitted
+  transaction, whose DS1307_async_complete must not come after it*/
+void DS1307_I2C_init(void *bus);
+uint8_t time_i2c_write_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte);
+uint8_t time_i2c_write_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length);
+uint8_t time_i2c_read_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte);
+uint8_t time_i2c_read_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length);
+void time_i2c_recover(void *bus);
+uint32_t time_tick_us();
+uint32_t time_tick_ms();
+void time_i2c_submit(void *bus, struct ds1307_transaction *transaction);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,159 @@
+/*ds1307 c++ driver header file - Reza Ebrahimi v1.0*/
+/*header only template driver. the register, mask and bcd handling of every field is a compile time
+  descriptor, so read<Field::Minute>(value) is one bus call and a few instructions with no option switch.
+  the bus is a template parameter too: any class with read() and write() members of the CBus shape.
+  the c api in rtc_ds1307.c stays available for everything else (snapshots, async, stats)*/
+#ifndef RTC_DS1307_HPP
+#define RTC_DS1307_HPP
+
+#include <stdint.h>
+#include "rtc_ds1307.h"
+
+namespace rtc_ds1307 {
+
+enum class Field : uint8_t {Second, Minute, Hour, DayOfWeek, Date, Month, Year, Control};
+
+/*register address, the bits of the register that hold the value and if the value is bcd*/
+template <uint8_t RegisterAddress, uint8_t ValueMask, bool Bcd>
+struct FieldDescriptor {
+  static constexpr uint8_t address = RegisterAddress;
+  static constexpr uint8_t mask = ValueMask;
+  static constexpr bool bcd = Bcd;
+};
+
+template <Field F> struct FieldTraits;
+template <> struct FieldTraits<Field::Second> : FieldDescriptor<DS1307_REGISTER_SECONDS, 0X7F, true> {};        /*CH left out*/
+template <> struct FieldTraits<Field::Minute> : FieldDescriptor<DS1307_REGISTER_MINUTES, 0X7F, true> {};
+template <> struct FieldTraits<Field::Hour> : FieldDescriptor<DS1307_REGISTER_HOURS, 0X3F, true> {};        /*24 hours, AMPM left out*/
+template <> struct FieldTraits<Field::DayOfWeek> : FieldDescriptor<DS1307_REGISTER_DAY_OF_WEEK, 0X07, true> {};
+template <> struct FieldTraits<Field::Date> : FieldDescriptor<DS1307_REGISTER_DATE, 0X3F, true> {};
+template <> struct FieldTraits<Field::Month> : FieldDescriptor<DS1307_REGISTER_MONTH, 0X1F, true> {};
+template <> struct FieldTraits<Field::Year> : FieldDescriptor<DS1307_REGISTER_YEAR, 0XFF, true> {};
+template <> struct FieldTraits<Field::Control> : FieldDescriptor<DS1307_REGISTER_CONTROL, 0XFF, false> {};
+
+constexpr uint8_t bcd_to_binary(uint8_t value)
+{
+  return ((value >> 4) * 10) + (value & 0X0F);
+}
+
+constexpr uint8_t binary_to_bcd(uint8_t value)
+{
+  return ((value / 10) << 4) | (value % 10);
+}
+
+/*value mask of the index-th byte of a burst from SECONDS, same as FieldTraits*/
+constexpr uint8_t time_mask(uint8_t index)
+{
+  return (index == 0) ? 0X7F : (index == 1) ? 0X7F : (index == 2) ? 0X3F : (index == 3) ? 0X07 : (index == 4) ? 0X3F : (index == 5) ? 0X1F : 0XFF;
+}
+
+/*bus adapter over the low level api of the c driver (time_i2c_*), bus is the pointer that
+  DS1307_handle_init would get (NULL for single bus ports). read and write return OPERATION_DONE or
+  OPERATION_FAILED, a failure is not retried here*/
+class CBus {
+ public:
+  explicit CBus(void *bus = 0) : bus_(bus) {}
+  uint8_t read(uint8_t device_address, uint8_t register_address, uint8_t *data_array, uint8_t data_length) const
+  {
+    if (data_length == 1)
+      return time_i2c_read_single(bus_, device_address, register_address, data_array);
+    return time_i2c_read_multi(bus_, device_address, register_address, data_array, data_length);
+  }
+  uint8_t write(uint8_t device_address, uint8_t register_address, uint8_t *data_array, uint8_t data_length) const
+  {
+    if (data_length == 1)
+      return time_i2c_write_single(bus_, device_address, register_address, data_array);
+    return time_i2c_write_multi(bus_, device_address, register_address, data_array, data_length);
+  }
+ private:
+  void *bus_;
+};
+
+template <class Bus = CBus, uint8_t Address = DS1307_I2C_ADDRESS>
+class Ds1307 {
+ public:
+  explicit Ds1307(Bus bus = Bus()) : bus_(bus) {}
+
+  /*one single byte read, decoded into value (read<Field::Minute>(value) gives 0 to 59). returns
+    OPERATION_DONE or OPERATION_FAILED, a failed read leaves value as it was*/
+  template <Field F>
+  uint8_t read(uint8_t &value) const
+  {
+    uint8_t register_value;
+    if (bus_.read(Address, FieldTraits<F>::address, &register_value, 1) != OPERATION_DONE)
+      return OPERATION_FAILED;
+    register_value &= FieldTraits<F>::mask;
+    value = FieldTraits<F>::bcd ? bcd_to_binary(register_value) : register_value;
+    return OPERATION_DONE;
+  }
+
+  /*one single byte write. SECONDS is read first so CH (the run state) is kept*/
+  template <Field F>
+  uint8_t write(uint8_t value)
+  {
+    uint8_t register_value;
+    uint8_t register_new_value = (FieldTraits<F>::bcd ? binary_to_bcd(value) : value) & FieldTraits<F>::mask;
+    if (FieldTraits<F>::address == DS1307_REGISTER_SECONDS)
+    {
+      if (bus_.read(Address, DS1307_REGISTER_SECONDS, &register_value, 1) != OPERATION_DONE)
+        return OPERATION_FAILED;
+      register_new_value |= register_value & (1 << DS1307_BIT_SETTING_CH);
+    }
+    return bus_.write(Address, FieldTraits<F>::address, &register_new_value, 1);
+  }
+
+  /*seconds to year in one burst, same layout as DS1307_read(TIME). returns DS1307_IS_RUNNING or
+    DS1307_IS_STOPPED, a failed read is DS1307_IS_STOPPED and leaves data_array undefined*/
+  uint8_t read_time(uint8_t *data_array) const
+  {
+    uint8_t run_state;
+    if (bus_.read(Address, DS1307_REGISTER_SECONDS, data_array, 7) != OPERATION_DONE)
+      return DS1307_IS_STOPPED;
+    run_state = (data_array[0] & (1 << DS1307_BIT_SETTING_CH)) ? DS1307_IS_STOPPED : DS1307_IS_RUNNING;
+    for (uint8_t index = 0; index < 7; index++)
+      data_array[index] = bcd_to_binary(data_array[index] & time_mask(index));
+    return run_state;
+  }
+
+  /*seconds to year in one burst, CH is kept*/
+  uint8_t write_time(const uint8_t *data_array)
+  {
+    uint8_t register_new_value[7];
+    uint8_t register_value;
+    if (bus_.read(Address, DS1307_REGISTER_SECONDS, &register_value, 1) != OPERATION_DONE)
+      return OPERATION_FAILED;
+    for (uint8_t index = 0; index < 7; index++)
+      register_new_value[index] = binary_to_bcd(data_array[index]) & time_mask(index);
+    register_new_value[0] |= register_value & (1 << DS1307_BIT_SETTING_CH);
+    return bus_.write(Address, DS1307_REGISTER_SECONDS, register_new_value, 7);
+  }
+
+  /*CLOCK_RUN or CLOCK_HALT, the seconds are kept*/
+  uint8_t run(uint8_t run_state)
+  {
+    uint8_t register_value;
+    if (bus_.read(Address, DS1307_REGISTER_SECONDS, &register_value, 1) != OPERATION_DONE)
+      return OPERATION_FAILED;
+    if (run_state == CLOCK_RUN)
+      register_value &= (~(1 << DS1307_BIT_SETTING_CH));
+    else
+      register_value |= (1 << DS1307_BIT_SETTING_CH);
+    return bus_.write(Address, DS1307_REGISTER_SECONDS, &register_value, 1);
+  }
+
+  /*a failed read is DS1307_IS_STOPPED, as with DS1307_run_state*/
+  uint8_t run_state() const
+  {
+    uint8_t register_value;
+    if (bus_.read(Address, DS1307_REGISTER_SECONDS, &register_value, 1) != OPERATION_DONE)
+      return DS1307_IS_STOPPED;
+    return (register_value & (1 << DS1307_BIT_SETTING_CH)) ? DS1307_IS_STOPPED : DS1307_IS_RUNNING;
+  }
+
+ private:
+  Bus bus_;
+};
+
+}
+
+#endif
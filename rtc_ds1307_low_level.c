@@ -1,27 +1,64 @@
 /*ds1307 low level api - Reza Ebrahimi v1.0*/
 #include "rtc_ds1307.h"
+/*bus is the pointer given to DS1307_handle_init, use it to tell several i2c peripherals apart*/
+
+/*every transfer returns OPERATION_DONE, or OPERATION_FAILED on a NACK, a lost arbitration or when it
+  is not over within DS1307_I2C_TIMEOUT_US (give every busy wait of the peripheral that deadline)*/
 
 /*function to transmit one byte of data to register_address on ds1307*/
-void time_i2c_write_single(uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+uint8_t time_i2c_write_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
 {
+  return OPERATION_DONE;
 }
 
 /*function to transmit an array of data to device_address, starting from start_register_address*/
-void time_i2c_write_multi(uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+uint8_t time_i2c_write_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
 {
+  return OPERATION_DONE;
 }
 
 /*function to read one byte of data from register_address on ds1307*/
-void time_i2c_read_single(uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
+uint8_t time_i2c_read_single(void *bus, uint8_t device_address, uint8_t register_address, uint8_t *data_byte)
 {
+  return OPERATION_DONE;
 }
 
 /*function to read an array of data from device_address*/
-void time_i2c_read_multi(uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+uint8_t time_i2c_read_multi(void *bus, uint8_t device_address, uint8_t start_register_address, uint8_t *data_array, uint8_t data_length)
+{
+  return OPERATION_DONE;
+}
+
+/*function to free the bus after a failed transfer, called before it is tried again. if SDA is held
+  low clock SCL up to 9 times until it is released, send a STOP and reset the i2c peripheral. a
+  submitted transaction still on the bus is dropped, without a DS1307_async_complete*/
+void time_i2c_recover(void *bus)
 {
 }
 
 /*function to initialize I2C peripheral in 100khz*/
-void DS1307_I2C_init()
+void DS1307_I2C_init(void *bus)
+{
+}
+
+#if DS1307_ASYNC
+/*function to start a transaction on the bus and return, DS1307_async_complete(transaction->rtc, status)
+  is called once it is over. start the transfer from here and call DS1307_async_complete from the
+  i2c (or dma) interrupt when STOP is sent*/
+void time_i2c_submit(void *bus, struct ds1307_transaction *transaction)
+{
+}
+#endif
+
+/*function to return a free running monotonic microsecond counter, used by DS1307_now*/
+uint32_t time_tick_us()
+{
+  return 0;
+}
+
+/*function to return a free running monotonic millisecond counter, ages the DS1307_now anchor past
+  the wrap of time_tick_us*/
+uint32_t time_tick_ms()
 {
+  return 0;
 }